@@ -0,0 +1,22 @@
+#pragma once
+#include <chrono>
+
+namespace Bench
+{
+	// Wall clock milliseconds of the best of a few runs of the functor. The machines running these are noisy, the minimum is the most stable.
+	template<class Func>
+	double bestOf( int runs, Func fn )
+	{
+		using Clock = std::chrono::steady_clock;
+		double best = 1e30;
+		for( int i = 0; i < runs; i++ )
+		{
+			const Clock::time_point start = Clock::now();
+			fn();
+			const double ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+			if( ms < best )
+				best = ms;
+		}
+		return best;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+// Atlas packing benchmark: replays glyph size sequences, reports the packing time and the occupancy.
+// The sequences are the FreeType bitmap sizes of the fonts from the examples, padded like Context::placeGlyph, in a fixed shuffled order.
+// Compares the skyline of Atlas against the linear scan it replaced, checks they place every rectangle at the same position, and reports the shelf packer for reference.
+// Links Atlas and ShelfPacker sources and FreeType. Run from the repository root, or pass the directory with the fonts.
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "FontStash2/Atlas.h"
+#include "Stopwatch.h"
+
+using namespace FontStash2;
+
+namespace
+{
+	constexpr int runs = 3;
+
+	struct Size
+	{
+		short width, height;
+	};
+
+	struct Position
+	{
+		int x, y;
+		bool operator == ( const Position& p ) const
+		{
+			return x == p.x && y == p.y;
+		}
+	};
+
+	// The bottom-left skyline search as it was before the segment tree, copied from the old Atlas without the free list
+	class LinearSkyline
+	{
+		struct Node
+		{
+			int x, y, width;
+		};
+		int width, height;
+		std::vector<Node> nodes;
+
+		int rectFits( int i, int w, int h ) const
+		{
+			int x = nodes[ i ].x;
+			int y = nodes[ i ].y;
+			if( x + w > width )
+				return -1;
+			int spaceLeft = w;
+			while( spaceLeft > 0 )
+			{
+				if( i == (int)nodes.size() )
+					return -1;
+				y = std::max( y, nodes[ i ].y );
+				if( y + h > height )
+					return -1;
+				spaceLeft -= nodes[ i ].width;
+				++i;
+			}
+			return y;
+		}
+
+		void addSkylineLevel( int idx, int x, int y, int w, int h )
+		{
+			nodes.insert( nodes.begin() + idx, Node{ x, y + h, w } );
+
+			for( int i = idx + 1; i < (int)nodes.size(); i++ )
+			{
+				if( nodes[ i ].x >= nodes[ i - 1 ].x + nodes[ i - 1 ].width )
+					break;
+				const int shrink = nodes[ i - 1 ].x + nodes[ i - 1 ].width - nodes[ i ].x;
+				nodes[ i ].x += shrink;
+				nodes[ i ].width -= shrink;
+				if( nodes[ i ].width > 0 )
+					break;
+				nodes.erase( nodes.begin() + i );
+				i--;
+			}
+
+			for( int i = 0; i < (int)nodes.size() - 1; i++ )
+			{
+				if( nodes[ i ].y != nodes[ i + 1 ].y )
+					continue;
+				nodes[ i ].width += nodes[ i + 1 ].width;
+				nodes.erase( nodes.begin() + i + 1 );
+				i--;
+			}
+		}
+
+	public:
+		LinearSkyline( int w, int h ) :
+			width( w ), height( h )
+		{
+			nodes.push_back( Node{ 0, 0, w } );
+		}
+
+		bool addRect( int rw, int rh, int* rx, int* ry )
+		{
+			int besth = height, bestw = width, besti = -1;
+			int bestx = -1, besty = -1;
+			const int nnodes = (int)nodes.size();
+			for( int i = 0; i < nnodes; i++ )
+			{
+				const int y = rectFits( i, rw, rh );
+				if( y == -1 )
+					continue;
+				if( y + rh < besth || ( y + rh == besth && nodes[ i ].width < bestw ) )
+				{
+					besti = i;
+					bestw = nodes[ i ].width;
+					besth = y + rh;
+					bestx = nodes[ i ].x;
+					besty = y;
+				}
+			}
+			if( besti == -1 )
+				return false;
+			addSkylineLevel( besti, bestx, besty, rw, rh );
+			*rx = bestx;
+			*ry = besty;
+			return true;
+		}
+	};
+
+	// Bitmap sizes of every glyph in the charmap of the font at the pixel sizes. Every 4-th glyph also gets a variant blurred by 4 pixels.
+	bool collectSizes( FT_Library library, const std::string& path, const std::vector<int>& pixelSizes, std::vector<Size>& result )
+	{
+		FT_Face face;
+		if( 0 != FT_New_Face( library, path.c_str(), 0, &face ) )
+		{
+			printf( "Unable to open %s\n", path.c_str() );
+			return false;
+		}
+		for( int px : pixelSizes )
+		{
+			if( 0 != FT_Set_Pixel_Sizes( face, 0, px ) )
+				continue;
+			FT_UInt glyph;
+			int counter = 0;
+			for( FT_ULong cp = FT_Get_First_Char( face, &glyph ); 0 != glyph; cp = FT_Get_Next_Char( face, cp, &glyph ) )
+			{
+				if( 0 != FT_Load_Glyph( face, glyph, FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT ) )
+					continue;
+				const FT_Bitmap& bmp = face->glyph->bitmap;
+				if( 0 == bmp.width || 0 == bmp.rows )
+					continue;
+				// Same as Context::placeGlyph, the padding is the blur + 2 pixels
+				for( int blur : { 0, 4 } )
+				{
+					if( 0 != blur && 0 != ( counter % 4 ) )
+						continue;
+					const int pad = blur + 2;
+					result.push_back( Size{ (short)( bmp.width + pad * 2 ), (short)( bmp.rows + pad * 2 ) } );
+				}
+				counter++;
+			}
+		}
+		FT_Done_Face( face );
+		return true;
+	}
+
+	struct Result
+	{
+		double ms;
+		int placed;
+		int64_t area;
+	};
+
+	template<class Packer, class Factory>
+	Result replay( Factory create, const std::vector<Size>& rects, std::vector<Position>& positions )
+	{
+		Result res{};
+		res.ms = Bench::bestOf( runs, [ & ]()
+		{
+			Packer packer = create();
+			positions.assign( rects.size(), Position{ -1, -1 } );
+			res.placed = 0;
+			res.area = 0;
+			for( size_t i = 0; i < rects.size(); i++ )
+			{
+				if( !packer.addRect( rects[ i ].width, rects[ i ].height, &positions[ i ].x, &positions[ i ].y ) )
+					continue;
+				res.placed++;
+				res.area += (int)rects[ i ].width * rects[ i ].height;
+			}
+		} );
+		return res;
+	}
+
+	void runScenario( const char* name, const std::vector<Size>& rects, int atlasSize )
+	{
+		const double atlasArea = (double)atlasSize * atlasSize;
+		std::vector<Position> linearPositions, treePositions, shelfPositions;
+
+		const Result linear = replay<LinearSkyline>( [ = ]() { return LinearSkyline( atlasSize, atlasSize ); }, rects, linearPositions );
+		const Result tree = replay<Atlas>( [ = ]() { return Atlas( atlasSize, atlasSize, 256 ); }, rects, treePositions );
+		const Result shelf = replay<Atlas>( [ = ]() { return Atlas( atlasSize, atlasSize, 256, true ); }, rects, shelfPositions );
+
+		printf( "%-12s %6d rects into %dx%d\n", name, (int)rects.size(), atlasSize, atlasSize );
+		printf( "    skyline, linear scan    %7.1f ms   %6d placed, %5.1f%%\n", linear.ms, linear.placed, 100.0 * linear.area / atlasArea );
+		printf( "    skyline, segment tree   %7.1f ms   %6d placed, %5.1f%%   positions %s\n", tree.ms, tree.placed, 100.0 * tree.area / atlasArea,
+			linearPositions == treePositions ? "identical" : "DIFFERENT" );
+		printf( "    shelves                 %7.1f ms   %6d placed, %5.1f%%\n", shelf.ms, shelf.placed, 100.0 * shelf.area / atlasArea );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	const std::string dir = argc > 1 ? argv[ 1 ] : "example";
+
+	FT_Library library;
+	if( 0 != FT_Init_FreeType( &library ) )
+	{
+		printf( "FreeType failed to initialize\n" );
+		return 1;
+	}
+
+	// The text sizes of a typical UI, regular and bold
+	std::vector<Size> ui;
+	const std::vector<int> uiSizes = { 12, 14, 16, 18, 20, 24, 28, 32 };
+	// Every glyph of the fonts, from 12 to 64 pixels
+	std::vector<Size> all;
+	std::vector<int> allSizes;
+	for( int px = 12; px <= 64; px += 4 )
+		allSizes.push_back( px );
+
+	bool ok = true;
+	for( const char* file : { "Roboto-Regular.ttf", "Roboto-Bold.ttf" } )
+		ok = ok && collectSizes( library, dir + "/" + file, uiSizes, ui );
+	for( const char* file : { "Roboto-Regular.ttf", "Roboto-Bold.ttf", "NotoEmoji-Regular.ttf" } )
+		ok = ok && collectSizes( library, dir + "/" + file, allSizes, all );
+	FT_Done_FreeType( library );
+	if( !ok )
+		return 1;
+
+	std::mt19937 rng( 1 );
+	std::shuffle( ui.begin(), ui.end(), rng );
+	std::shuffle( all.begin(), all.end(), rng );
+
+	printf( "Best of %d runs\n", runs );
+	runScenario( "UI", ui, 2048 );
+	runScenario( "Everything", all, 2048 );
+	runScenario( "Everything", all, 4096 );
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+// Glyph cache lookup microbenchmark: the std::unordered_map with PlexAlloc this fork used before, GlyphMap, and GlyphMap behind Latin1Cache like Font::lookupGlyph.
+// Header only, build with e.g. g++ -std=c++14 -O2 -Isrc bench/glyphMapBench.cpp
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include <stdexcept>
+#include "FontStash2/GlyphMap.h"
+#include "FontStash2/Latin1Cache.h"
+#include "FontStash2/PlexAlloc/Allocator.hpp"
+#include "Stopwatch.h"
+
+using namespace FontStash2;
+
+namespace
+{
+	// The key and the hasher of the old Font::glyphs map, copied verbatim
+	struct OldKey
+	{
+		unsigned int codepoint;
+		short size;
+		short blur;
+
+		bool operator == ( const OldKey &k ) const
+		{
+			return codepoint == k.codepoint && size == k.size && blur == k.blur;
+		}
+	};
+
+	struct OldKeyHash
+	{
+		std::size_t operator()( const OldKey& k ) const
+		{
+			std::size_t hash = 17;
+			hash = hash * 31 + k.codepoint;
+			hash = hash * 31 + (uint16_t)k.size;
+			hash = hash * 31 + (uint16_t)k.blur;
+			return hash;
+		}
+	};
+
+	using OldAlloc = PlexAlloc::Allocator<std::pair<const OldKey, GlyphValue>, 128>;
+	using OldMap = std::unordered_map<OldKey, GlyphValue, OldKeyHash, std::equal_to<OldKey>, OldAlloc>;
+
+	// Same as Font::lookupGlyph, Font itself needs FreeType
+	GlyphValue* lookupLatin1( GlyphMap& glyphs, Latin1Cache& latin1, const GlyphKey& key )
+	{
+		if( !Latin1Cache::covers( key.codepoint() ) )
+			return glyphs.find( key );
+
+		GlyphValue* res = latin1.lookup( key );
+		if( nullptr != res )
+			return res;
+		res = glyphs.find( key );
+		if( nullptr != res )
+			latin1.store( key, res );
+		return res;
+	}
+
+	constexpr int rounds = 20;
+	constexpr int lookupsPerRound = 500000;
+	constexpr int runs = 3;
+
+	// Text sizes, in the same units as FONSstate::size * 10
+	const short sizes[] = { 120, 140, 180, 240 };
+	constexpr size_t countSizes = sizeof( sizes ) / sizeof( sizes[ 0 ] );
+
+	// Random glyphs at random sizes, or runs of text like the draw calls make, 32 random glyphs per run at the same size
+	enum struct Pattern : uint8_t
+	{
+		Random,
+		TextRuns,
+	};
+	constexpr int textRunLength = 32;
+
+	void runScenario( const char* name, const std::vector<unsigned int>& codepoints, Pattern pattern )
+	{
+		std::vector<GlyphKey> keys;
+		for( short s : sizes )
+			for( unsigned int cp : codepoints )
+				keys.push_back( GlyphKey{ cp, s, 0 } );
+
+		OldMap oldMap;
+		GlyphMap glyphs;
+		Latin1Cache latin1;
+		for( size_t i = 0; i < keys.size(); i++ )
+		{
+			const GlyphKey& k = keys[ i ];
+			oldMap[ OldKey{ k.codepoint(), k.size(), k.blur() } ].index = (uint32_t)i;
+			glyphs.insert( k )->index = (uint32_t)i;
+		}
+
+		// Lookups of the glyphs in the cache, the same sequence for all maps
+		std::mt19937 rng( 1 );
+		std::uniform_int_distribution<size_t> dist( 0, keys.size() - 1 );
+		std::uniform_int_distribution<size_t> distCodepoint( 0, codepoints.size() - 1 );
+		std::vector<GlyphKey> lookups( lookupsPerRound );
+		for( size_t i = 0; i < lookups.size(); i++ )
+		{
+			if( Pattern::Random == pattern )
+				lookups[ i ] = keys[ dist( rng ) ];
+			else
+			{
+				const size_t run = i / textRunLength;
+				lookups[ i ] = keys[ ( run % countSizes ) * codepoints.size() + distCodepoint( rng ) ];
+			}
+		}
+
+		// Summed and printed so the compiler can't drop the lookups
+		uint64_t checksum = 0;
+
+		const double msOld = Bench::bestOf( runs, [ & ]()
+		{
+			for( int r = 0; r < rounds; r++ )
+				for( const GlyphKey& k : lookups )
+					checksum += oldMap.find( OldKey{ k.codepoint(), k.size(), k.blur() } )->second.index;
+		} );
+
+		const double msFlat = Bench::bestOf( runs, [ & ]()
+		{
+			for( int r = 0; r < rounds; r++ )
+				for( const GlyphKey& k : lookups )
+					checksum += glyphs.find( k )->index;
+		} );
+
+		const double msLatin1 = Bench::bestOf( runs, [ & ]()
+		{
+			for( int r = 0; r < rounds; r++ )
+				for( const GlyphKey& k : lookups )
+					checksum += lookupLatin1( glyphs, latin1, k )->index;
+		} );
+
+		printf( "%-8s %-10s %6d glyphs   unordered_map %7.1f ms   GlyphMap %7.1f ms   Latin1Cache + GlyphMap %7.1f ms   (%llu)\n",
+			name, Pattern::Random == pattern ? "random" : "text runs", (int)keys.size(), msOld, msFlat, msLatin1, (unsigned long long)checksum );
+	}
+}
+
+int main()
+{
+	printf( "%d x %d lookups, best of %d runs\n", rounds, lookupsPerRound, runs );
+
+	std::vector<unsigned int> ascii;
+	for( unsigned int cp = 0x20; cp < 0x7F; cp++ )
+		ascii.push_back( cp );
+	runScenario( "ASCII", ascii, Pattern::Random );
+	runScenario( "ASCII", ascii, Pattern::TextRuns );
+
+	// The ASCII above plus the first CJK ideographs, 3000 codepoints in total
+	std::vector<unsigned int> cjk = ascii;
+	for( unsigned int cp = 0x4E00; cjk.size() < 3000; cp++ )
+		cjk.push_back( cp );
+	runScenario( "CJK mix", cjk, Pattern::Random );
+	runScenario( "CJK mix", cjk, Pattern::TextRuns );
+	return 0;
+}
\ No newline at end of file
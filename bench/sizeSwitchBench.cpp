@@ -0,0 +1,113 @@
+// Cost of a glyph miss when the text interleaves sizes: FT_Set_Pixel_Sizes per glyph like this fork did before, against the FT_Size objects FontFace keeps per pixel size.
+// Links the FontStash2 sources and FreeType. The optional argument is the font file, the default is the Roboto from the examples.
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "FontStash2/FontFace.h"
+#include "FontStash2/FontSource.h"
+#include "Stopwatch.h"
+
+using namespace FontStash2;
+
+namespace
+{
+	constexpr int runs = 3;
+	constexpr int switches = 1000000;
+	constexpr int misses = 20000;
+
+	// Pixel sizes of a UI which mixes body text, headings and small print, cycled glyph by glyph
+	const uint32_t sizes[] = { 14, 28, 18, 12 };
+	constexpr int countSizes = sizeof( sizes ) / sizeof( sizes[ 0 ] );
+
+	// Switches the size of the face for every glyph
+	struct SetPixelSizes
+	{
+		FT_Face face;
+		bool operator()( uint32_t pixels ) const
+		{
+			return 0 == FT_Set_Pixel_Sizes( face, 0, pixels );
+		}
+	};
+
+	// Activates the size object FontFace keeps for the size
+	struct ActivateSize
+	{
+		FontFace* face;
+		bool operator()( uint32_t pixels ) const
+		{
+			return face->activatePixelSize( pixels );
+		}
+	};
+
+	template<class Switch>
+	double measureSwitch( Switch sw )
+	{
+		return Bench::bestOf( runs, [ & ]()
+		{
+			for( int i = 0; i < switches; i++ )
+				if( !sw( sizes[ i % countSizes ] ) )
+					printf( "Size switch failed\n" );
+		} ) * 1000.0 / switches;
+	}
+
+	// Switch the size and load the glyph like Font::buildGlyphBitmap does, cycling through the sizes and the lowercase letters
+	template<class Switch>
+	double measureMiss( Switch sw, FT_Face face, FT_Int32 loadFlags )
+	{
+		const FT_UInt first = FT_Get_Char_Index( face, 'a' );
+		return Bench::bestOf( runs, [ & ]()
+		{
+			for( int i = 0; i < misses; i++ )
+			{
+				const FT_UInt glyph = FT_Get_Char_Index( face, 'a' + i % 26 );
+				if( !sw( sizes[ i % countSizes ] ) || 0 != FT_Load_Glyph( face, 0 != glyph ? glyph : first, loadFlags ) )
+					printf( "Glyph load failed\n" );
+			}
+		} ) * 1000.0 / misses;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	const char* const path = argc > 1 ? argv[ 1 ] : "example/Roboto-Regular.ttf";
+
+	FreetypeReference library;
+	if( !library.acquired() )
+	{
+		printf( "FreeType failed to initialize\n" );
+		return 1;
+	}
+
+	// Two sources over the same file open two faces, so the size objects of one don't interfere with the other
+	std::shared_ptr<const FontSource> file = FontSource::mapFile( path );
+	if( !file )
+	{
+		printf( "Unable to read %s\n", path );
+		return 1;
+	}
+	std::shared_ptr<FontFace> before = FontFace::open( FontSource::fromExternal( file->data(), file->size() ) );
+	std::shared_ptr<FontFace> after = FontFace::open( FontSource::fromExternal( file->data(), file->size() ) );
+	if( !before || !after )
+	{
+		printf( "Unable to open %s\n", path );
+		return 1;
+	}
+
+	const SetPixelSizes setPixelSizes{ before->get() };
+	const ActivateSize activateSize{ after.get() };
+
+	printf( "%s, sizes 14/28/18/12 interleaved, best of %d runs, microseconds per glyph\n", path, runs );
+	printf( "%-28s FT_Set_Pixel_Sizes %7.3f   FT_Activate_Size %7.3f\n", "size switch alone",
+		measureSwitch( setPixelSizes ), measureSwitch( activateSize ) );
+
+	// The flags Font::buildGlyphBitmap uses, and the same without the autohinter, when the font's own hinting program runs
+	const FT_Int32 autohint = FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT;
+	const FT_Int32 bytecode = FT_LOAD_RENDER;
+	printf( "%-28s FT_Set_Pixel_Sizes %7.3f   FT_Activate_Size %7.3f\n", "glyph miss, autohinter",
+		measureMiss( setPixelSizes, before->get(), autohint ), measureMiss( activateSize, after->get(), autohint ) );
+	printf( "%-28s FT_Set_Pixel_Sizes %7.3f   FT_Activate_Size %7.3f\n", "glyph miss, font hinting",
+		measureMiss( setPixelSizes, before->get(), bytecode ), measureMiss( activateSize, after->get(), bytecode ) );
+	return 0;
+}
\ No newline at end of file
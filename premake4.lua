@@ -224,3 +224,82 @@ solution "nanovg"
 		configuration "Release"
 			defines { "NDEBUG" }
 			flags { "Optimize", "ExtraWarnings"}
+
+	-- Microbenchmarks of the text rendering internals, optional, they're not needed to build the library or the examples
+	project "bench_glyphmap"
+		kind "ConsoleApp"
+		language "C++"
+		files { "bench/glyphMapBench.cpp", "bench/Stopwatch.h" }
+		includedirs { "src", "bench" }
+		targetdir("build")
+
+		configuration { "linux" }
+			 buildoptions { "-std=c++14" }
+
+		configuration { "macosx" }
+			 buildoptions { "-std=c++14" }
+
+		configuration "Debug"
+			defines { "DEBUG" }
+			flags { "Symbols", "ExtraWarnings"}
+
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "ExtraWarnings"}
+
+	project "bench_sizeswitch"
+		kind "ConsoleApp"
+		language "C++"
+		files { "bench/sizeSwitchBench.cpp", "bench/Stopwatch.h", "src/FontStash2/*.cpp" }
+		includedirs { "src", "bench" }
+		targetdir("build")
+
+		configuration { "linux" }
+			 buildoptions { "-std=c++14", "`pkg-config --cflags freetype2`" }
+			 linkoptions { "`pkg-config --libs freetype2`" }
+			 links { "pthread" }
+
+		configuration { "windows" }
+			 includedirs { "../freetype-2.10.0/include" }
+			 links { "freetype" }
+			 defines { "_CRT_SECURE_NO_WARNINGS" }
+
+		configuration { "macosx" }
+			 buildoptions { "-std=c++14", "`pkg-config --cflags freetype2`" }
+			 linkoptions { "`pkg-config --libs freetype2`" }
+
+		configuration "Debug"
+			defines { "DEBUG" }
+			flags { "Symbols", "ExtraWarnings"}
+
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "ExtraWarnings"}
+
+	project "bench_atlas"
+		kind "ConsoleApp"
+		language "C++"
+		files { "bench/atlasBench.cpp", "bench/Stopwatch.h", "src/FontStash2/Atlas.cpp", "src/FontStash2/ShelfPacker.cpp" }
+		includedirs { "src", "bench" }
+		targetdir("build")
+
+		configuration { "linux" }
+			 buildoptions { "-std=c++14", "`pkg-config --cflags freetype2`" }
+			 linkoptions { "`pkg-config --libs freetype2`" }
+
+		configuration { "windows" }
+			 includedirs { "../freetype-2.10.0/include" }
+			 links { "freetype" }
+			 defines { "_CRT_SECURE_NO_WARNINGS" }
+
+		configuration { "macosx" }
+			 buildoptions { "-std=c++14", "`pkg-config --cflags freetype2`" }
+			 linkoptions { "`pkg-config --libs freetype2`" }
+
+		configuration "Debug"
+			defines { "DEBUG" }
+			flags { "Symbols", "ExtraWarnings"}
+
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "ExtraWarnings"}
@@ -0,0 +1,62 @@
+#include "AsyncRasterizer.h"
+
+namespace FontStash2
+{
+	AsyncRasterizer::AsyncRasterizer( size_t capacity ) :
+		requests( capacity ),
+		results( capacity )
+	{
+		sleeping = false;
+		quit = false;
+		thread = std::thread( &AsyncRasterizer::threadMain, this );
+	}
+
+	AsyncRasterizer::~AsyncRasterizer()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			quit = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+	bool AsyncRasterizer::submit( RasterJob&& job )
+	{
+		if( !requests.push( std::move( job ) ) )
+			return false;
+
+		// Pairs with the fence in threadMain(): either the thread sees the new job, or this sees the flag and wakes it up
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if( sleeping.load( std::memory_order_relaxed ) )
+		{
+			// Locking orders the notification after the thread started waiting, or before it checked the queue
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+			}
+			wake.notify_one();
+		}
+		return true;
+	}
+
+	void AsyncRasterizer::threadMain()
+	{
+		RasterJob job;
+		while( !quit.load( std::memory_order_relaxed ) )
+		{
+			if( requests.pop( job ) )
+			{
+				faces.rasterize( job );
+				// Never full, the calling thread keeps the jobs in flight below the capacity
+				results.push( std::move( job ) );
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock( mutex );
+			sleeping.store( true, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			wake.wait( lock, [ this ] { return quit.load( std::memory_order_relaxed ) || !requests.empty(); } );
+			sleeping.store( false, std::memory_order_relaxed );
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "RasterPool.h"
+#include "SpscQueue.hpp"
+
+namespace FontStash2
+{
+	// Rasterizes glyphs on a background thread while the calling thread keeps drawing.
+	// The calling thread submits the jobs and takes the results, both through lock-free queues, the mutex is only used to wake up the idle thread.
+	// The thread has its own RasterFaces, so the fonts must outlive this object.
+	class AsyncRasterizer
+	{
+		RasterFaces faces;
+		SpscQueue<RasterJob> requests, results;
+		std::thread thread;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		// Set by the thread before it checks the requests and waits, submit() only locks the mutex when it's set
+		std::atomic<bool> sleeping;
+		std::atomic<bool> quit;
+
+		void threadMain();
+
+	public:
+
+		// Both queues have that many slots, rounded up to a power of 2
+		AsyncRasterizer( size_t capacity );
+		~AsyncRasterizer();
+		AsyncRasterizer( const AsyncRasterizer& ) = delete;
+		void operator=( const AsyncRasterizer& ) = delete;
+
+		size_t capacity() const
+		{
+			return requests.capacity();
+		}
+
+		// Queue the job for the thread. Returns false when the queue is full.
+		// Keep the count of jobs not taken back below capacity(), the thread has nowhere to put more results.
+		bool submit( RasterJob&& job );
+
+		// Take a finished job, with the bitmap and job.ok set. Returns false when none are finished yet.
+		bool takeResult( RasterJob& job )
+		{
+			return results.pop( job );
+		}
+	};
+}
\ No newline at end of file
@@ -3,16 +3,19 @@
 #include <limits.h>
 using namespace FontStash2;
 
-Atlas::Atlas( int w, int h, int nnodes )
+Atlas::Atlas( int w, int h, int nnodes, bool shelves )
 {
 	width = w;
 	height = h;
+	shelfPacking = shelves;
+	shelf.reset( w, h );
 
 	// Allocate space for skyline nodes
 	nodes.reserve( nnodes );
 
 	// Init root node
 	nodes.emplace_back( Node{ 0, 0, w } );
+	updateTree( 0 );
 }
 
 void Atlas::reset( int w, int h )
@@ -20,94 +23,308 @@ void Atlas::reset( int w, int h )
 	width = w;
 	height = h;
 	nodes.clear();
+	freeList.clear();
+	shelf.reset( w, h );
 
 	// Init root node
 	nodes.emplace_back( Node{ 0, 0, w } );
+	updateTree( 0 );
 }
 
-int Atlas::rectFits( int i, int w, int h ) const
+void Atlas::setShelfPacking( bool shelves )
+{
+	shelfPacking = shelves;
+	reset( width, height );
+}
+
+void Atlas::syncShelfTop()
+{
+	nodes[ 0 ].y = (short)shelf.getTop();
+	updateTree( 0 );
+}
+
+bool Atlas::isValidSkyline( int w, int h, const std::vector<Node>& nodes )
+{
+	int x = 0;
+	for( const Node& n : nodes )
+	{
+		if( n.x != x || n.width <= 0 || n.y < 0 || n.y > h )
+			return false;
+		x += n.width;
+	}
+	return !nodes.empty() && x == w;
+}
+
+bool Atlas::isValidFreeList( int w, int h, const std::vector<Rect>& rects )
+{
+	for( const Rect& r : rects )
+		if( r.x < 0 || r.y < 0 || r.width <= 0 || r.height <= 0 || r.x + r.width > w || r.y + r.height > h )
+			return false;
+	return true;
+}
+
+bool Atlas::isValidShelfFreeList( const std::vector<ShelfPacker::Shelf>& shelves, const std::vector<Rect>& rects )
+{
+	for( const Rect& r : rects )
+		if( !ShelfPacker::isValidFreeSlot( shelves, r.x, r.y, r.width, r.height ) )
+			return false;
+	return true;
+}
+
+void Atlas::restore( int w, int h, std::vector<Node>& newNodes, std::vector<Rect>& freeRects, const std::vector<ShelfPacker::Shelf>& shelves )
+{
+	width = w;
+	height = h;
+	if( shelfPacking )
+	{
+		shelf.restore( w, h, shelves );
+		for( const Rect& r : freeRects )
+			shelf.restoreFreeSlot( r.x, r.y, r.width, r.height );
+		freeList.clear();
+		nodes.clear();
+		nodes.emplace_back( Node{ 0, 0, w } );
+		syncShelfTop();
+		return;
+	}
+	nodes.swap( newNodes );
+	freeList.swap( freeRects );
+	updateTree( 0 );
+}
+
+void Atlas::updateTree( int from )
+{
+	const int count = (int)nodes.size();
+	if( count > treeLeaves )
+	{
+		treeLeaves = 16;
+		while( treeLeaves < count )
+			treeLeaves *= 2;
+		heightMin.assign( 2 * treeLeaves, SHRT_MAX );
+		heightMax.assign( 2 * treeLeaves, SHRT_MIN );
+		from = 0;
+		treeCount = 0;
+	}
+
+	// The leaves after the last node were shifted down by the removed nodes
+	const int end = std::max( count, treeCount );
+	treeCount = count;
+	if( from >= end )
+		return;
+	for( int i = from; i < end; i++ )
+	{
+		const int v = treeLeaves + i;
+		heightMin[ v ] = i < count ? nodes[ i ].y : SHRT_MAX;
+		heightMax[ v ] = i < count ? nodes[ i ].y : SHRT_MIN;
+	}
+	for( int l = ( treeLeaves + from ) / 2, r = ( treeLeaves + end - 1 ) / 2; l >= 1; l /= 2, r /= 2 )
+	{
+		for( int v = l; v <= r; v++ )
+		{
+			heightMin[ v ] = std::min( heightMin[ v * 2 ], heightMin[ v * 2 + 1 ] );
+			heightMax[ v ] = std::max( heightMax[ v * 2 ], heightMax[ v * 2 + 1 ] );
+		}
+	}
+}
+
+int Atlas::findLowNode( int begin, int end, int maxY ) const
+{
+	if( begin >= end )
+		return -1;
+
+	// Climb from the leaf to the first subtree on the right which has a low enough node
+	int v = begin + treeLeaves;
+	while( heightMin[ v ] > maxY )
+	{
+		while( v & 1 )
+			v /= 2;
+		// Climbed past the root, i.e. all the nodes to the right are too high
+		if( v == 0 )
+			return -1;
+		v++;
+	}
+
+	// Descend to the leftmost leaf of that subtree with a low enough node
+	while( v < treeLeaves )
+	{
+		v *= 2;
+		if( heightMin[ v ] > maxY )
+			v++;
+	}
+	const int i = v - treeLeaves;
+	return i < end ? i : -1;
+}
+
+int Atlas::rectFits( int i, int w, int h, int maxY ) const
 {
 	// Checks if there is enough space at the location of skyline span 'i',
 	// and return the max height of all skyline spans under that at that location,
-	// (think tetris block being dropped at that position). Or -1 if no space found.
-	int x = nodes[ i ].x;
-	int y = nodes[ i ].y;
-	int spaceLeft;
+	// (think tetris block being dropped at that position). Or -1 if no space found, or if the block would rest above maxY.
+	const int x = nodes[ i ].x;
 	if( x + w > width )
 		return -1;
-	spaceLeft = w;
-	while( spaceLeft > 0 )
+	maxY = std::min( maxY, height - h );
+	int y = nodes[ i ].y;
+	// The spans are sorted and cover the complete width, the ones under the block start before x + w
+	const int right = x + w;
+	const int count = (int)nodes.size();
+	for( ; i < count && nodes[ i ].x < right; i++ )
 	{
-		if( i == (int)nodes.size() )
-			return -1;
 		y = std::max( y, (int)nodes[ i ].y );
-		if( y + h > height )
+		if( y > maxY )
 			return -1;
-		spaceLeft -= nodes[ i ].width;
-		++i;
 	}
 	return y;
 }
 
-void Atlas::insertNode( int idx, int x, int y, int w )
+void Atlas::addSkylineLevel( int idx, int x, int y, int w, int h )
 {
-	nodes.insert( nodes.begin() + idx, std::move( Node{ x, y, w } ) );
+	// Insert new node
+	nodes.insert( nodes.begin() + idx, Node{ x, y + h, w } );
+
+	// Delete skyline segments that fall under the shadow of the new segment, and shrink the one which is partially covered.
+	const int right = x + w;
+	int end = idx + 1;
+	while( end < (int)nodes.size() && nodes[ end ].x + nodes[ end ].width <= right )
+		end++;
+	nodes.erase( nodes.begin() + idx + 1, nodes.begin() + end );
+	if( idx + 1 < (int)nodes.size() && nodes[ idx + 1 ].x < right )
+	{
+		const int shrink = right - nodes[ idx + 1 ].x;
+		nodes[ idx + 1 ].x += (short)shrink;
+		nodes[ idx + 1 ].width -= (short)shrink;
+	}
+
+	// Merge same height skyline segments that are next to each other. The rest of the skyline is already merged, only the neighbors of the new segment may need it.
+	if( idx + 1 < (int)nodes.size() && nodes[ idx + 1 ].y == nodes[ idx ].y )
+	{
+		nodes[ idx ].width += nodes[ idx + 1 ].width;
+		nodes.erase( nodes.begin() + idx + 1 );
+	}
+	if( idx > 0 && nodes[ idx - 1 ].y == nodes[ idx ].y )
+	{
+		nodes[ idx - 1 ].width += nodes[ idx ].width;
+		nodes.erase( nodes.begin() + idx );
+	}
+
+	updateTree( std::max( idx - 1, 0 ) );
 }
 
-void Atlas::removeNode( int idx )
+bool Atlas::addFreeListRect( int rw, int rh, int* rx, int* ry )
 {
-	nodes.erase( nodes.begin() + idx );
+	int best = -1;
+	int bestArea = INT_MAX;
+	const int count = (int)freeList.size();
+	for( int i = 0; i < count; i++ )
+	{
+		const Rect& r = freeList[ i ];
+		if( r.width < rw || r.height < rh )
+			continue;
+		const int area = (int)r.width * r.height;
+		if( area < bestArea )
+		{
+			best = i;
+			bestArea = area;
+		}
+	}
+	if( best < 0 )
+		return false;
+
+	const Rect r = freeList[ best ];
+	freeList.erase( freeList.begin() + best );
+	*rx = r.x;
+	*ry = r.y;
+	reusedCount++;
+
+	// Split the rest of the rectangle along the shorter leftover axis, which keeps the larger piece as big as possible
+	const int rightWidth = r.width - rw;
+	const int bottomHeight = r.height - rh;
+	if( rightWidth > bottomHeight )
+	{
+		if( rightWidth > 0 )
+			freeList.push_back( Rect{ (short)( r.x + rw ), r.y, (short)rightWidth, r.height } );
+		if( bottomHeight > 0 )
+			freeList.push_back( Rect{ r.x, (short)( r.y + rh ), (short)rw, (short)bottomHeight } );
+	}
+	else
+	{
+		if( rightWidth > 0 )
+			freeList.push_back( Rect{ (short)( r.x + rw ), r.y, (short)rightWidth, (short)rh } );
+		if( bottomHeight > 0 )
+			freeList.push_back( Rect{ r.x, (short)( r.y + rh ), r.width, (short)bottomHeight } );
+	}
+	return true;
 }
 
-void Atlas::addSkylineLevel( int idx, int x, int y, int w, int h )
+void Atlas::freeRect( int x, int y, int w, int h )
 {
-	int i;
+	if( shelfPacking )
+	{
+		shelf.freeRect( x, y, w );
+		return;
+	}
 
-	// Insert new node
-	insertNode( idx, x, y + h, w );
+	Rect n{ (short)x, (short)y, (short)w, (short)h };
 
-	// Delete skyline segments that fall under the shadow of the new segment.
-	for( i = idx + 1; i < (int)nodes.size(); i++ )
+	// Merge with the neighbors which share a complete edge, repeat while the merged rectangle finds more of them
+	for( bool merged = true; merged; )
 	{
-		if( nodes[ i ].x < nodes[ i - 1 ].x + nodes[ i - 1 ].width )
+		merged = false;
+		for( size_t i = 0; i < freeList.size(); i++ )
 		{
-			int shrink = nodes[ i - 1 ].x + nodes[ i - 1 ].width - nodes[ i ].x;
-			nodes[ i ].x += (short)shrink;
-			nodes[ i ].width -= (short)shrink;
-			if( nodes[ i ].width <= 0 )
+			const Rect& r = freeList[ i ];
+			if( r.y == n.y && r.height == n.height && ( r.x + r.width == n.x || n.x + n.width == r.x ) )
+			{
+				n.x = std::min( n.x, r.x );
+				n.width += r.width;
+			}
+			else if( r.x == n.x && r.width == n.width && ( r.y + r.height == n.y || n.y + n.height == r.y ) )
 			{
-				removeNode( i );
-				i--;
+				n.y = std::min( n.y, r.y );
+				n.height += r.height;
 			}
 			else
-				break;
-		}
-		else
+				continue;
+			freeList.erase( freeList.begin() + i );
+			merged = true;
 			break;
-	}
-
-	// Merge same height skyline segments that are next to each other.
-	for( i = 0; i < (int)nodes.size() - 1; i++ )
-	{
-		if( nodes[ i ].y == nodes[ i + 1 ].y )
-		{
-			nodes[ i ].width += nodes[ i + 1 ].width;
-			removeNode( i + 1 );
-			i--;
 		}
 	}
+	freeList.push_back( n );
+}
+
+bool Atlas::hasFreeRect( int w, int h ) const
+{
+	if( shelfPacking )
+		return shelf.canAdd( w, h );
+	for( const Rect& r : freeList )
+		if( r.width >= w && r.height >= h )
+			return true;
+	return false;
 }
 
 bool Atlas::addRect( int rw, int rh, int* rx, int* ry )
 {
+	if( shelfPacking )
+	{
+		if( !shelf.addRect( rw, rh, rx, ry ) )
+			return false;
+		syncShelfTop();
+		return true;
+	}
+
+	if( !freeList.empty() && addFreeListRect( rw, rh, rx, ry ) )
+		return true;
+
 	int besth = height, bestw = width, besti = -1;
-	int bestx = -1, besty = -1, i;
+	int bestx = -1, besty = -1;
 
 	// Bottom left fit heuristic.
-	const int nnodes = (int)nodes.size();
-	for( i = 0; i < nnodes; i++ )
+	// The spans starting after width - rw can't fit the rectangle. The rectangle dropped at a span rests at least at the height of that span,
+	// only the spans not higher than the best position found so far may improve it, the segment tree skips the rest.
+	const int nnodes = (int)( std::upper_bound( nodes.begin(), nodes.end(), width - rw, []( int v, const Node& n ) { return v < n.x; } ) - nodes.begin() );
+	for( int i = findLowNode( 0, nnodes, besth - rh ); i >= 0; i = findLowNode( i + 1, nnodes, besth - rh ) )
 	{
-		int y = rectFits( i, rw, rh );
+		int y = rectFits( i, rw, rh, besth - rh );
 		if( y != -1 )
 		{
 			if( y + rh < besth || ( y + rh == besth && nodes[ i ].width < bestw ) )
@@ -133,17 +350,50 @@ bool Atlas::addRect( int rw, int rh, int* rx, int* ry )
 
 void Atlas::expand( int w, int h )
 {
-	// Insert node for empty space
+	if( shelfPacking )
+	{
+		shelf.expand( w, h );
+		nodes[ 0 ].width = (short)w;
+		width = w;
+		height = h;
+		return;
+	}
+
+	// Insert node for empty space, or extend the last one if it's empty too, the skyline stays merged
 	if( w > width )
-		insertNode( (int)nodes.size(), width, 0, w - width );
+	{
+		if( nodes.back().y == 0 )
+			nodes.back().width += (short)( w - width );
+		else
+			nodes.emplace_back( Node{ width, 0, w - width } );
+		updateTree( (int)nodes.size() - 1 );
+	}
 	width = w;
 	height = h;
 }
 
 int Atlas::getMaxY() const
 {
-	int i = INT_MIN;
+	return heightMax[ 1 ];
+}
+
+int Atlas::getFreeArea() const
+{
+	if( shelfPacking )
+		return shelf.getFreeArea();
+	int res = 0;
+	for( auto& n : nodes )
+		res += (int)n.width * ( height - n.y );
+	for( auto& r : freeList )
+		res += (int)r.width * r.height;
+	return res;
+}
+
+int Atlas::getOpenArea() const
+{
+	// In the shelf mode the only node is the top of the shelves
+	int res = 0;
 	for( auto& n : nodes )
-		i = std::max( i, (int)n.y );
-	return i;
+		res += (int)n.width * ( height - n.y );
+	return res;
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 ﻿#pragma once
 #include <vector>
+#include "ShelfPacker.h"
 
 namespace FontStash2
 {
 	// Atlas based on Skyline Bin Packer by Jukka Jylänki
+	// The bottom-left search is accelerated with a segment tree over the heights of the skyline nodes, the packing is the same as the linear scan in the original code.
+	// Optionally, the rectangles are allocated by ShelfPacker instead, then the skyline is a single node at the bottom of the shelves.
 	class Atlas
 	{
 	public:
@@ -18,32 +21,108 @@ namespace FontStash2
 			{ }
 		};
 
+		// Rectangle released by the evicted glyphs, available for reuse
+		struct Rect
+		{
+			short x, y, width, height;
+		};
+
 		// fons__allocAtlas
-		Atlas( int w, int h, int nnodes );
+		Atlas( int w, int h, int nnodes, bool shelfPacking = false );
+
+		// Switch between the skyline and the shelf packer, this resets the atlas
+		void setShelfPacking( bool shelves );
 
+		bool isShelfPacking() const
+		{
+			return shelfPacking;
+		}
+
+		const ShelfPacker& shelfPacker() const
+		{
+			return shelf;
+		}
+
+		// Reuses the free rectangles first, then allocates above the skyline
 		bool addRect( int rw, int rh, int* rx, int* ry );
 
+		// Release the rectangle of an evicted glyph, for addRect() to reuse
+		void freeRect( int x, int y, int w, int h );
+
+		// True if one of the free rectangles can fit the w*h rectangle
+		bool hasFreeRect( int w, int h ) const;
+
+		const std::vector<Rect>& freeRects() const
+		{
+			return freeList;
+		}
+
+		// Count of addRect() calls which reused a free rectangle
+		int getReusedCount() const
+		{
+			return shelfPacking ? shelf.getReusedCount() : reusedCount;
+		}
+
 		void expand( int w, int h );
 
 		void reset( int w, int h );
 
 		int getMaxY() const;
 
+		// Area above the skyline plus the free rectangles, in pixels, i.e. the space still available for new glyphs.
+		int getFreeArea() const;
+
+		// Area above the skyline, or above the top shelf, in pixels. Unlike getFreeArea() this excludes the holes left by the evicted glyphs.
+		int getOpenArea() const;
+
 		const std::vector<Node>& atlasNodes() const
 		{
 			return nodes;
 		}
+
+		// True if the nodes are a complete skyline of the w*h atlas: sorted, without gaps nor overlaps, and within the size.
+		static bool isValidSkyline( int w, int h, const std::vector<Node>& nodes );
+
+		// True if the free rectangles are within the w*h atlas
+		static bool isValidFreeList( int w, int h, const std::vector<Rect>& rects );
+
+		// True if the free rectangles are valid free slots of the shelves
+		static bool isValidShelfFreeList( const std::vector<ShelfPacker::Shelf>& shelves, const std::vector<Rect>& rects );
+
+		// Replace the state with the one loaded from a cache file. The nodes must pass isValidSkyline() test, the free rectangles isValidFreeList().
+		// With the shelf packer, the shelves must pass ShelfPacker::isValidShelves(), and the free rectangles isValidShelfFreeList().
+		void restore( int w, int h, std::vector<Node>& nodes, std::vector<Rect>& freeRects, const std::vector<ShelfPacker::Shelf>& shelves );
 		
 	private:
 		int width, height;
 		std::vector<Node> nodes;
+		// Implicit segment tree over nodes[ i ].y, leaves are at [ treeLeaves, 2 * treeLeaves ). Unused leaves have SHRT_MAX minimum and SHRT_MIN maximum.
+		std::vector<short> heightMin, heightMax;
+		int treeLeaves = 0;
+		// Count of the leaves written by the last update, the leaves after that are unused
+		int treeCount = 0;
+		// Guillotine free list, populated when glyphs are evicted. Adjacent rectangles with a common edge are merged.
+		std::vector<Rect> freeList;
+		int reusedCount = 0;
+		bool shelfPacking = false;
+		ShelfPacker shelf;
 
-		// fons__atlasRectFits
-		int rectFits( int i, int w, int h ) const;
+		// Copy the bottom of the shelves into the single skyline node
+		void syncShelfTop();
 
-		void addSkylineLevel( int idx, int x, int y, int w, int h );
+		// Best area fit in the free list, returns false if none of them fit
+		bool addFreeListRect( int rw, int rh, int* rx, int* ry );
+
+		// fons__atlasRectFits: the max height of the nodes under w pixels starting at the node i.
+		// Returns -1 if the rectangle doesn't fit, or if that height is above maxY, the walk stops as soon as it is.
+		int rectFits( int i, int w, int h, int maxY ) const;
 
-		void insertNode( int idx, int x, int y, int w );
-		void removeNode( int idx );
+		// Rewrite the leaves from the index to the end of the nodes, and their ancestors. Rebuilds the complete tree when the node count outgrows it.
+		void updateTree( int from );
+
+		// First node in [ begin, end ) range with height <= maxY, or -1 if none of them
+		int findLowNode( int begin, int end, int maxY ) const;
+
+		void addSkylineLevel( int idx, int x, int y, int w, int h );
 	};
 }
\ No newline at end of file
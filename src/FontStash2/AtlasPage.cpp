@@ -0,0 +1,81 @@
+#include "AtlasPage.h"
+#include <limits.h>
+using namespace FontStash2;
+
+namespace
+{
+	inline int rectArea( const int* r )
+	{
+		return ( r[ 2 ] - r[ 0 ] ) * ( r[ 3 ] - r[ 1 ] );
+	}
+
+	inline void unionRect( int* r, const int* other )
+	{
+		r[ 0 ] = std::min( r[ 0 ], other[ 0 ] );
+		r[ 1 ] = std::min( r[ 1 ], other[ 1 ] );
+		r[ 2 ] = std::max( r[ 2 ], other[ 2 ] );
+		r[ 3 ] = std::max( r[ 3 ], other[ 3 ] );
+	}
+
+	// Area of the bounding box of both rectangles
+	inline int unionArea( const int* a, const int* b )
+	{
+		int r[ 4 ] = { a[ 0 ], a[ 1 ], a[ 2 ], a[ 3 ] };
+		unionRect( r, b );
+		return rectArea( r );
+	}
+}
+
+void AtlasPage::addDirty( int x0, int y0, int x1, int y1 )
+{
+	if( x0 >= x1 || y0 >= y1 )
+		return;
+	int r[ 4 ] = { x0, y0, x1, y1 };
+
+	// Merge with the close rectangles, when the bounding box is at most twice their area. Repeat while the grown rectangle finds more of them.
+	for( bool merged = true; merged; )
+	{
+		merged = false;
+		for( int i = 0; i < dirtyCount; i++ )
+		{
+			if( unionArea( r, dirtyRects[ i ] ) > 2 * ( rectArea( r ) + rectArea( dirtyRects[ i ] ) ) )
+				continue;
+			unionRect( r, dirtyRects[ i ] );
+			std::copy_n( dirtyRects[ --dirtyCount ], 4, dirtyRects[ i ] );
+			merged = true;
+			break;
+		}
+	}
+
+	if( dirtyCount == FONS_MAX_DIRTY_RECTS )
+	{
+		// No room for another one, merge with the rectangle which grows the least
+		int best = 0;
+		int bestGrowth = INT_MAX;
+		for( int i = 0; i < dirtyCount; i++ )
+		{
+			const int growth = unionArea( r, dirtyRects[ i ] ) - rectArea( dirtyRects[ i ] );
+			if( growth < bestGrowth )
+			{
+				best = i;
+				bestGrowth = growth;
+			}
+		}
+		unionRect( r, dirtyRects[ best ] );
+		std::copy_n( dirtyRects[ --dirtyCount ], 4, dirtyRects[ best ] );
+	}
+	std::copy_n( r, 4, dirtyRects[ dirtyCount++ ] );
+}
+
+int AtlasPage::takeDirty( int* rects, int maxRects )
+{
+	if( maxRects <= 0 )
+		return 0;
+	const int count = std::min( dirtyCount, maxRects );
+	for( int i = 0; i < count; i++ )
+		std::copy_n( dirtyRects[ i ], 4, rects + i * 4 );
+	for( int i = count; i < dirtyCount; i++ )
+		unionRect( rects + ( count - 1 ) * 4, dirtyRects[ i ] );
+	dirtyCount = 0;
+	return count;
+}
\ No newline at end of file
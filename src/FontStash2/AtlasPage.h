@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include "Atlas.h"
+#include "RamTexture.h"
+
+// Count of the dirty rectangles per page, more of them are merged
+#ifndef FONS_MAX_DIRTY_RECTS
+#	define FONS_MAX_DIRTY_RECTS 8
+#endif
+
+namespace FontStash2
+{
+	// One page of the glyph atlas: the texture in system RAM, the rectangle packer, and the rectangles to upload to GPU
+	class AtlasPage
+	{
+	public:
+#ifdef NANOVG_CLEARTYPE
+		using Texel = uint32_t;
+#else
+		using Texel = uint8_t;
+#endif
+		RamTexture<Texel> texture;
+		Atlas atlas;
+		// Rectangles to upload, x0, y0, x1, y1. The close ones are merged, so a few glyphs far apart don't upload everything between them.
+		int dirtyRects[ FONS_MAX_DIRTY_RECTS ][ 4 ];
+		int dirtyCount = 0;
+
+		AtlasPage( int w, int h, int nnodes, bool shelfPacking ) :
+			atlas( w, h, nnodes, shelfPacking )
+		{
+		}
+
+		void clearDirty()
+		{
+			dirtyCount = 0;
+		}
+
+		// Replace the dirty rectangles with the one
+		void setDirty( int x0, int y0, int x1, int y1 )
+		{
+			dirtyCount = 0;
+			addDirty( x0, y0, x1, y1 );
+		}
+
+		void addDirty( int x0, int y0, int x1, int y1 );
+
+		bool isDirty() const
+		{
+			return dirtyCount > 0;
+		}
+
+		// Copy up to maxRects dirty rectangles and clear them, the ones which don't fit are merged into the last one. Returns count of the rectangles.
+		int takeDirty( int* rects, int maxRects );
+	};
+}
\ No newline at end of file
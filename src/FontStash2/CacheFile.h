@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include "GlyphMap.h"
+
+namespace FontStash2
+{
+	// Layout of the glyph cache files written by Context::saveCache, and loaded by Context::loadCache.
+	// The numbers are in the native byte order, the structures are written with memcpy. The file is only valid for the same build of the library,
+	// the header has everything which affects the rendered glyphs, the loader rejects files which don't match.
+	// The file is the header, then for every font a CacheFileFont followed by the fallback indices as uint32_t, then CacheFileGlyph for every cached glyph.
+	// After the fonts, for every page of the atlas a CacheFilePage, skyline nodes of the page as CacheFileNode, free rectangles as CacheFileRect,
+	// shelves as CacheFileShelf when the shelf packer is used, then width * height texels of the page texture.
+	namespace CacheFile
+	{
+		// "FSC2" in the file
+		constexpr uint32_t magic = 0x32435346;
+		// Increment when changing any of the structures below, the layout of GlyphValue, or the texels of the rendered glyphs
+		constexpr uint32_t version = 5;
+	}
+
+	struct CacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		// FreeType version and load flags, the rendered glyphs depend on both
+		uint32_t freetypeVersion;
+		uint32_t loadFlags;
+		// Bytes per texel: 1 for grayscale, 4 for ClearType builds
+		uint32_t texelSize;
+		int32_t width, height;
+		uint32_t countFonts;
+		uint32_t countPages;
+		// FONSatlasPacker value, must match the context
+		uint32_t packer;
+	};
+
+	struct CacheFileFont
+	{
+		// Hash of the font file. Fonts are matched by index, the hash must be equal to the hash of the font at that index in the context.
+		uint64_t contentHash;
+		uint32_t countFallbacks;
+		uint32_t countGlyphs;
+	};
+
+	// GlyphValue::lastUsed is not meaningful in another process, the loader resets it to 0
+	struct CacheFileGlyph
+	{
+		uint64_t key;
+		GlyphValue value;
+	};
+
+	struct CacheFilePage
+	{
+		uint32_t countNodes;
+		uint32_t countFreeRects;
+		uint32_t countShelves;
+	};
+
+	struct CacheFileNode
+	{
+		int16_t x, y, width;
+	};
+
+	struct CacheFileRect
+	{
+		int16_t x, y, width, height;
+	};
+
+	struct CacheFileShelf
+	{
+		int16_t y, height, cursor;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,347 @@
+#include "Context.h"
+#include "CacheFile.h"
+#include "FileHandles.h"
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+using namespace FontStash2;
+
+namespace
+{
+	// Sequential reader over the mapped cache file, fails on reads past the end
+	class CacheReader
+	{
+		const uint8_t* pointer;
+		const uint8_t* const end;
+
+	public:
+		CacheReader( const MappedFile& file ) :
+			pointer( file.data() ),
+			end( file.data() + file.size() )
+		{ }
+
+		template<class E>
+		bool read( E& e )
+		{
+			if( (size_t)( end - pointer ) < sizeof( E ) )
+				return false;
+			memcpy( &e, pointer, sizeof( E ) );
+			pointer += sizeof( E );
+			return true;
+		}
+
+		// Returns pointer to the bytes, or nullptr if the file is too short
+		const uint8_t* skip( size_t cb )
+		{
+			if( (size_t)( end - pointer ) < cb )
+				return nullptr;
+			const uint8_t* const res = pointer;
+			pointer += cb;
+			return res;
+		}
+
+		size_t remaining() const
+		{
+			return (size_t)( end - pointer );
+		}
+	};
+
+	CacheFileHeader makeHeader()
+	{
+		CacheFileHeader h;
+		memset( &h, 0, sizeof( h ) );
+		h.magic = CacheFile::magic;
+		h.version = CacheFile::version;
+		h.freetypeVersion = freetypeVersion();
+		h.loadFlags = freetypeLoadFlags();
+#ifdef NANOVG_CLEARTYPE
+		h.texelSize = sizeof( uint32_t );
+#else
+		h.texelSize = sizeof( uint8_t );
+#endif
+		return h;
+	}
+}
+
+bool Context::saveCache( const char* path )
+{
+	WriteFileHandle file{ path };
+	if( !file )
+		return false;
+
+	CacheFileHeader header = makeHeader();
+	header.width = params.width;
+	header.height = params.height;
+	header.countFonts = (uint32_t)fonts.size();
+	header.countPages = (uint32_t)pages.size();
+	header.packer = (uint32_t)packer;
+	if( !file.writeStructure( header ) )
+		return false;
+
+	std::vector<CacheFileGlyph> glyphs;
+	for( auto& f : fonts )
+	{
+		glyphs.clear();
+		f->forEachGlyph( [ &glyphs ]( GlyphKey key, const GlyphValue& value )
+		{
+			CacheFileGlyph g;
+			memset( &g, 0, sizeof( g ) );
+			g.key = key.bits;
+			g.value = value;
+			glyphs.push_back( g );
+		} );
+
+		CacheFileFont rec;
+		memset( &rec, 0, sizeof( rec ) );
+		rec.contentHash = f->getContentHash();
+		rec.countFallbacks = (uint32_t)f->getFallbackFonts().size();
+		rec.countGlyphs = (uint32_t)glyphs.size();
+		if( !file.writeStructure( rec ) )
+			return false;
+		for( int i : f->getFallbackFonts() )
+			if( !file.writeStructure( (uint32_t)i ) )
+				return false;
+		if( !file.writeVector( glyphs ) )
+			return false;
+	}
+
+	std::vector<CacheFileNode> nodes;
+	std::vector<CacheFileRect> rects;
+	std::vector<CacheFileShelf> shelves;
+	const size_t texels = (size_t)params.width * params.height;
+	for( const AtlasPage& page : pages )
+	{
+		CacheFilePage rec;
+		rec.countNodes = (uint32_t)page.atlas.atlasNodes().size();
+		rects.clear();
+		if( page.atlas.isShelfPacking() )
+		{
+			page.atlas.shelfPacker().forEachFreeSlot( [ &rects ]( int x, int y, int w, int h )
+			{
+				rects.push_back( CacheFileRect{ (int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h } );
+			} );
+		}
+		else
+		{
+			for( const auto& r : page.atlas.freeRects() )
+				rects.push_back( CacheFileRect{ r.x, r.y, r.width, r.height } );
+		}
+		shelves.clear();
+		for( const auto& s : page.atlas.shelfPacker().getShelves() )
+			shelves.push_back( CacheFileShelf{ s.y, s.height, s.cursor } );
+		rec.countFreeRects = (uint32_t)rects.size();
+		rec.countShelves = page.atlas.isShelfPacking() ? (uint32_t)shelves.size() : 0;
+		if( !file.writeStructure( rec ) )
+			return false;
+
+		nodes.clear();
+		for( const auto& n : page.atlas.atlasNodes() )
+			nodes.push_back( CacheFileNode{ n.x, n.y, n.width } );
+		if( !file.writeVector( nodes ) )
+			return false;
+
+		if( !file.writeVector( rects ) )
+			return false;
+		if( rec.countShelves > 0 && !file.writeVector( shelves ) )
+			return false;
+
+		if( !file.write( page.texture.data(), texels * header.texelSize ) )
+			return false;
+	}
+	return true;
+}
+
+bool Context::loadCache( const char* path )
+{
+	MappedFile file{ path };
+	if( !file )
+		return false;
+	CacheReader reader{ file };
+
+	// Validate everything before changing any state, stale or truncated files leave the context as it was
+	CacheFileHeader header;
+	if( !reader.read( header ) )
+		return false;
+	const CacheFileHeader expected = makeHeader();
+	if( header.magic != expected.magic || header.version != expected.version )
+		return false;
+	if( header.freetypeVersion != expected.freetypeVersion || header.loadFlags != expected.loadFlags || header.texelSize != expected.texelSize )
+		return false;
+	if( header.width <= 0 || header.height <= 0 || header.width > SHRT_MAX || header.height > SHRT_MAX )
+		return false;
+	if( header.countFonts > fonts.size() )
+		return false;
+	// The limit is set by the application, the file may only use as many pages
+	if( header.countPages < 1 || header.countPages > (uint32_t)maxPages || header.packer != (uint32_t)packer )
+		return false;
+
+	struct FontGlyphs
+	{
+		const uint8_t* glyphs;
+		uint32_t count;
+	};
+	std::vector<FontGlyphs> fontGlyphs;
+	fontGlyphs.reserve( header.countFonts );
+	for( uint32_t i = 0; i < header.countFonts; i++ )
+	{
+		FONSfont& font = *fonts[ i ];
+		CacheFileFont rec;
+		if( !reader.read( rec ) )
+			return false;
+		if( font.empty() || rec.contentHash != font.getContentHash() )
+			return false;
+
+		// The fallbacks affect which font renders the glyphs
+		const std::vector<int>& fallbacks = font.getFallbackFonts();
+		if( rec.countFallbacks != fallbacks.size() )
+			return false;
+		for( int fb : fallbacks )
+		{
+			uint32_t idx;
+			if( !reader.read( idx ) || idx != (uint32_t)fb )
+				return false;
+		}
+
+		if( rec.countGlyphs > reader.remaining() / sizeof( CacheFileGlyph ) )
+			return false;
+		const uint8_t* glyphs = reader.skip( (size_t)rec.countGlyphs * sizeof( CacheFileGlyph ) );
+		if( nullptr == glyphs )
+			return false;
+		for( uint32_t j = 0; j < rec.countGlyphs; j++ )
+		{
+			CacheFileGlyph g;
+			memcpy( &g, glyphs + j * sizeof( CacheFileGlyph ), sizeof( g ) );
+			if( g.value.page >= header.countPages )
+				return false;
+			// Compacting and evicting copy and clear the pixels of these rectangles
+			const GlyphValue& v = g.value;
+			if( v.hasBitmap() && ( v.x0 > v.x1 || v.x1 > header.width || v.y0 > v.y1 || v.y1 > header.height ) )
+				return false;
+		}
+		fontGlyphs.push_back( FontGlyphs{ glyphs, rec.countGlyphs } );
+	}
+
+	struct PageState
+	{
+		std::vector<Atlas::Node> nodes;
+		std::vector<Atlas::Rect> freeRects;
+		std::vector<ShelfPacker::Shelf> shelves;
+		const uint8_t* pixels;
+	};
+	std::vector<PageState> pageStates( header.countPages );
+	const size_t textureBytes = (size_t)header.width * header.height * header.texelSize;
+	for( PageState& ps : pageStates )
+	{
+		CacheFilePage rec;
+		if( !reader.read( rec ) )
+			return false;
+
+		if( rec.countNodes > reader.remaining() / sizeof( CacheFileNode ) )
+			return false;
+		ps.nodes.reserve( std::max( rec.countNodes, (uint32_t)FONS_INIT_ATLAS_NODES ) );
+		for( uint32_t i = 0; i < rec.countNodes; i++ )
+		{
+			CacheFileNode n;
+			if( !reader.read( n ) )
+				return false;
+			ps.nodes.emplace_back( n.x, n.y, n.width );
+		}
+		if( !Atlas::isValidSkyline( header.width, header.height, ps.nodes ) )
+			return false;
+
+		if( rec.countFreeRects > reader.remaining() / sizeof( CacheFileRect ) )
+			return false;
+		ps.freeRects.reserve( rec.countFreeRects );
+		for( uint32_t i = 0; i < rec.countFreeRects; i++ )
+		{
+			CacheFileRect r;
+			if( !reader.read( r ) )
+				return false;
+			ps.freeRects.push_back( Atlas::Rect{ r.x, r.y, r.width, r.height } );
+		}
+		if( !Atlas::isValidFreeList( header.width, header.height, ps.freeRects ) )
+			return false;
+
+		if( rec.countShelves > reader.remaining() / sizeof( CacheFileShelf ) )
+			return false;
+		ps.shelves.reserve( rec.countShelves );
+		for( uint32_t i = 0; i < rec.countShelves; i++ )
+		{
+			CacheFileShelf s;
+			if( !reader.read( s ) )
+				return false;
+			ps.shelves.push_back( ShelfPacker::Shelf{ s.y, s.height, s.cursor } );
+		}
+		if( packer == FONS_PACKER_SHELF && ( !ShelfPacker::isValidShelves( header.width, header.height, ps.shelves ) || !Atlas::isValidShelfFreeList( ps.shelves, ps.freeRects ) ) )
+			return false;
+
+		ps.pixels = reader.skip( textureBytes );
+		if( nullptr == ps.pixels )
+			return false;
+	}
+	if( reader.remaining() != 0 )
+		return false;
+
+	// The file is good, build the new pages aside, an allocation failure leaves the current atlas untouched
+	std::vector<AtlasPage> newPages;
+	try
+	{
+		newPages.reserve( header.countPages );
+		for( uint32_t i = 0; i < header.countPages; i++ )
+		{
+			newPages.emplace_back( header.width, header.height, FONS_INIT_ATLAS_NODES, packer == FONS_PACKER_SHELF );
+			AtlasPage& page = newPages.back();
+			if( !page.texture.assign( header.width, header.height, pageStates[ i ].pixels ) )
+				return false;
+			page.atlas.restore( header.width, header.height, pageStates[ i ].nodes, pageStates[ i ].freeRects, pageStates[ i ].shelves );
+		}
+	}
+	catch( const std::exception& )
+	{
+		return false;
+	}
+
+	// Replace the state
+	flush();
+	if( ( header.width != params.width || header.height != params.height ) && params.renderResize != NULL )
+	{
+		if( params.renderResize( params.userPtr, header.width, header.height ) == 0 )
+			return false;
+	}
+	pages.swap( newPages );
+	params.width = header.width;
+	params.height = header.height;
+	itw = 1.0f / params.width;
+	ith = 1.0f / params.height;
+
+	for( auto& f : fonts )
+		f->reset();
+	for( uint32_t i = 0; i < header.countFonts; i++ )
+	{
+		FONSfont& font = *fonts[ i ];
+		const uint8_t* p = fontGlyphs[ i ].glyphs;
+		for( uint32_t j = 0; j < fontGlyphs[ i ].count; j++, p += sizeof( CacheFileGlyph ) )
+		{
+			CacheFileGlyph g;
+			memcpy( &g, p, sizeof( g ) );
+			const GlyphKey key{ g.key };
+			g.value.lastUsed = 0;
+			*font.allocGlyph( key ) = g.value;
+		}
+	}
+	// The white rect is in the restored atlas too
+	liveArea = 4;
+	for( auto& f : fonts )
+	{
+		f->forEachGlyph( [ & ]( GlyphKey, GlyphValue& value )
+		{
+			if( value.hasBitmap() )
+				liveArea += ( value.x1 - value.x0 ) * ( value.y1 - value.y0 );
+		} );
+	}
+
+	// Upload the complete textures with a single update per page
+	for( AtlasPage& page : pages )
+		page.setDirty( 0, 0, params.width, std::max( page.atlas.getMaxY(), 1 ) );
+	return true;
+}
\ No newline at end of file
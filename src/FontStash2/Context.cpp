@@ -1,33 +1,29 @@
 #include <algorithm>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <chrono>
 #include "Context.h"
 #include "logger.h"
+#include "utf8.h"
 using namespace FontStash2;
 
 Context::Context( FONSparams* p ) :
 	params( *p ),
 	itw( 1.0f / (float)params.width ),
-	ith( 1.0f / (float)params.height ),
-	atlas( params.width, params.height, FONS_INIT_ATLAS_NODES )
+	ith( 1.0f / (float)params.height )
 {
 	memset( states, 0, sizeof( states ) );
+	pages.emplace_back( params.width, params.height, FONS_INIT_ATLAS_NODES, packer == FONS_PACKER_SHELF );
 }
 
 bool Context::initStuff()
 {
-	if( !FontStash2::freetypeInit() )
-		return false;
-
 	// Allocate space for fonts
 	fonts.reserve( FONS_INIT_FONTS );
 
 	// Create texture for the cache
-	ramTexture.resize( params.width, params.height );
-
-	dirtyRect[ 0 ] = params.width;
-	dirtyRect[ 1 ] = params.height;
-	dirtyRect[ 2 ] = 0;
-	dirtyRect[ 3 ] = 0;
+	pages[ 0 ].texture.resize( params.width, params.height );
 
 	// Add white rect at 0,0 for debug drawing.
 	addWhiteRect( 2, 2 );
@@ -40,17 +36,137 @@ bool Context::initStuff()
 
 void Context::addWhiteRect( int w, int h )
 {
+	AtlasPage& page = pages[ 0 ];
 	int gx, gy;
-	if( !atlas.addRect( w, h, &gx, &gy ) )
+	if( !page.atlas.addRect( w, h, &gx, &gy ) )
 		return;
 
 	// Rasterize
-	ramTexture.addWhiteRect( params.width, gx, gy, w, h );
+	page.texture.addWhiteRect( params.width, gx, gy, w, h );
+	page.addDirty( gx, gy, gx + w, gy + h );
+	liveArea += w * h;
+}
+
+bool Context::addPage()
+{
+	const size_t count = pages.size();
+	if( (int)count >= maxPages )
+		return false;
+	try
+	{
+		pages.emplace_back( params.width, params.height, FONS_INIT_ATLAS_NODES, packer == FONS_PACKER_SHELF );
+		if( pages.back().texture.resize( params.width, params.height ) )
+		{
+			atlasStats.pagesAdded++;
+			return true;
+		}
+	}
+	catch( const std::exception& )
+	{
+	}
+	// When emplace_back throws, nothing was appended, and the last page is a live one with glyphs on it
+	if( pages.size() > count )
+		pages.pop_back();
+	return false;
+}
 
-	dirtyRect[ 0 ] = std::min( dirtyRect[ 0 ], gx );
-	dirtyRect[ 1 ] = std::min( dirtyRect[ 1 ], gy );
-	dirtyRect[ 2 ] = std::max( dirtyRect[ 2 ], gx + w );
-	dirtyRect[ 3 ] = std::max( dirtyRect[ 3 ], gy + h );
+int Context::addRect( int w, int h, int* x, int* y )
+{
+	const int count = (int)pages.size();
+	for( int i = 0; i < count; i++ )
+		if( pages[ i ].atlas.addRect( w, h, x, y ) )
+			return i;
+	if( addPage() && pages.back().atlas.addRect( w, h, x, y ) )
+		return (int)pages.size() - 1;
+	return -1;
+}
+
+bool Context::resetAtlas( int width, int height )
+{
+	// Flush pending glyphs.
+	flush();
+
+	// Create new texture
+	if( params.renderResize != NULL )
+	{
+		if( params.renderResize( params.userPtr, width, height ) == 0 )
+			return false;
+	}
+
+	// Reset atlas, and clear texture data
+	pages.erase( pages.begin() + 1, pages.end() );
+	AtlasPage& page = pages[ 0 ];
+	page.atlas.reset( width, height );
+	if( !page.texture.resize( width, height ) )
+		return false;
+	page.clearDirty();
+
+	// Reset cached glyphs
+	for( auto& f : fonts )
+		f->reset();
+	atlasStats.atlasResets++;
+	liveArea = 0;
+
+	params.width = width;
+	params.height = height;
+	itw = 1.0f / params.width;
+	ith = 1.0f / params.height;
+
+	// Add white rect at 0,0 for debug drawing.
+	addWhiteRect( 2, 2 );
+	return true;
+}
+
+bool Context::setAtlasPacker( int newPacker )
+{
+	if( newPacker != FONS_PACKER_SKYLINE && newPacker != FONS_PACKER_SHELF )
+		return false;
+	if( newPacker == packer )
+		return true;
+	packer = newPacker;
+	for( AtlasPage& page : pages )
+		page.atlas.setShelfPacking( packer == FONS_PACKER_SHELF );
+	// The glyphs are gone with the old packer state
+	return resetAtlas( params.width, params.height );
+}
+
+int Context::getAtlasFreeArea() const
+{
+	int res = 0;
+	for( const AtlasPage& page : pages )
+		res += page.atlas.getFreeArea();
+	return res;
+}
+
+bool Context::expandAtlas( int width, int height )
+{
+	// Flush pending glyphs.
+	flush();
+
+	// Create new texture
+	if( params.renderResize != NULL )
+	{
+		if( params.renderResize( params.userPtr, width, height ) == 0 )
+			return false;
+	}
+
+	for( AtlasPage& page : pages )
+	{
+		if( !page.texture.expand( params.width, params.height, width, height ) )
+			return false;
+
+		// Increase atlas size
+		page.atlas.expand( width, height );
+
+		// Add existing data as dirty.
+		page.setDirty( 0, 0, params.width, page.atlas.getMaxY() );
+	}
+
+	params.width = width;
+	params.height = height;
+	itw = 1.0f / params.width;
+	ith = 1.0f / params.height;
+	return true;
 }
 
 
@@ -86,6 +202,7 @@ void Context::clearState()
 	state->font = 0;
 	state->blur = 0;
 	state->spacing = 0;
+	state->distanceField = 0;
 	state->align = FONS_ALIGN_LEFT | FONS_ALIGN_BASELINE;
 }
 
@@ -94,19 +211,23 @@ FONSstate* Context::getState()
 	return &states[ nstates - 1 ];
 }
 
-int Context::addFont( const char* name, std::vector<uint8_t>& data )
+int Context::addFont( const char* name, std::shared_ptr<const FontSource> data )
 {
+	if( nullptr == data )
+		return FONS_INVALID;
 	try
 	{
 		// Create the object
-		auto up = std::make_unique<FONSfont>( FONS_MAX_FALLBACKS );
+		const int res = (int)fonts.size();
+		if( res >= GlyphKey::maxFonts )
+			return FONS_INVALID;
+		auto up = std::make_unique<FONSfont>( res, FONS_MAX_FALLBACKS );
 
 		// Load the FreeType2 font
-		if( !up->initialize( name, data ) )
+		if( !up->initialize( name, std::move( data ) ) )
 			return FONS_INVALID;
 
 		// Move the new object to the vector
-		const int res = (int)fonts.size();
 		fonts.emplace_back( std::move( up ) );
 		return res;
 	}
@@ -116,77 +237,400 @@ int Context::addFont( const char* name, std::vector<uint8_t>& data )
 	}
 }
 
-GlyphValue* Context::getGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, int bitmapOption )
+FONSfont* Context::resolveGlyphIndex( FONSfont& font, unsigned int codepoint, uint32_t& glyphIndex )
 {
-#ifdef NANOVG_CLEARTYPE
-	if( iblur != 0 )
+	const CharmapEntry* cached = font.lookupCharmap( codepoint );
+	if( nullptr != cached )
 	{
-		iblur = 0;	// It's technically possible to implement clear type-aware blur, I just don't need it.
-		static bool warned = false;
-		if( !warned )
+		glyphIndex = cached->glyph;
+		return cached->font < 0 ? &font : fonts[ cached->font ].get();
+	}
+
+	uint32_t g = font.getGlyphIndex( codepoint );
+	int owner = -1;
+	// Try to find the glyph in fallback fonts.
+	if( g == 0 )
+	{
+		for( int idxFallback : font.getFallbackFonts() )
 		{
-			warned = false;
-			logWarning( "ClearType build is currently incompatible with blurred fonts. Disabled the blur." );
+			const uint32_t fallbackIndex = fonts[ idxFallback ]->getGlyphIndex( codepoint );
+			if( fallbackIndex != 0 )
+			{
+				g = fallbackIndex;
+				owner = idxFallback;
+				break;
+			}
 		}
+		// It is possible that we did not find a fallback glyph.
+		// In that case the glyph index 'g' is 0, and the caller will cache empty glyph.
 	}
-	
-#endif
+
+	font.cacheCharmap( codepoint, owner, g );
+	glyphIndex = g;
+	return owner < 0 ? &font : fonts[ owner ].get();
+}
+
+// Blur is limited to 20 pixels. ClearType builds blur the grayscale coverage, the blurred glyphs have no sub-pixels.
+// GlyphKey keeps the blur in 8 bits.
+static short clampBlur( short iblur )
+{
+	if( iblur > 20 ) iblur = 20;
+	if( iblur < 0 ) iblur = 0;
+	return iblur;
+}
+
+GlyphValue* Context::getGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, int bitmapOption )
+{
+	iblur = clampBlur( iblur );
 	const float size = isize / 10.0f;
-	FONSfont* renderFont = &font;
 
 	if( isize < 2 )
 		return NULL;
-	if( iblur > 20 ) iblur = 20;
 	const int pad = iblur + 2;
 
-	// Reset allocator.
-	scratch.clear();
-
 	// Find code point and size.
-	GlyphValue* glyph = font.lookupGlyph( codepoint, isize, iblur );
+	const GlyphKey key{ codepoint, isize, iblur, phase };
+	GlyphValue* glyph = font.lookupGlyph( key );
 	if( nullptr != glyph )
-		if( bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || glyph->hasBitmap() )
+	{
+		if( bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL )
 			return glyph;
+		if( glyph->hasBitmap() )
+		{
+			glyph->lastUsed = frame;
+			return glyph;
+		}
+	}
+
+	// Blurred bitmaps are made from the sharp glyph, so text with a shadow loads the glyph from FreeType once
+	if( iblur > 0 && bitmapOption == FONS_GLYPH_BITMAP_REQUIRED )
+		return deriveBlurredGlyph( font, codepoint, isize, iblur, phase );
 
 	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	uint32_t g = font.getGlyphIndex( codepoint );
-	// Try to find the glyph in fallback fonts.
-	if( g == 0 )
+	uint32_t g;
+	FONSfont* renderFont = resolveGlyphIndex( font, codepoint, g );
+	GlyphMetrics metrics;
+	renderFont->buildGlyphBitmap( g, size, phase, metrics );
+	glyph = placeGlyph( font, key, renderFont->getPixelHeightScale( size ), g, metrics, bitmapOption );
+	if( nullptr == glyph || bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL )
+		return glyph;
+
+	// Rasterize. The glyph slot with the pixels is in the font which has the glyph, which is not the base font for the fallback glyphs.
+	pages[ glyph->page ].texture.addGlyph( *renderFont, params.width, glyph, pad );
+	commitGlyph( glyph, iblur );
+	return glyph;
+}
+
+GlyphValue* Context::deriveBlurredGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase )
+{
+	const GlyphValue* sharp = getGlyph( font, codepoint, isize, 0, phase, FONS_GLYPH_BITMAP_REQUIRED );
+	if( nullptr == sharp )
+		return nullptr;
+
+	// Copy the pixels out, placing the blurred glyph may evict the sharp one, or the error callback may reset the atlas
+	const int sw = sharp->x1 - sharp->x0;
+	const int sh = sharp->y1 - sharp->y0;
+	sharpPixels.resize( (size_t)sw * sh );
+	pages[ sharp->page ].texture.readRect( params.width, sharp->x0, sharp->y0, sw, sh, sharpPixels.data() );
+
+	// The metrics of the bitmap inside the 2 pixels of padding of the sharp glyph
+	GlyphMetrics metrics;
+	metrics.advance = 0;
+	metrics.lsb = 0;
+	metrics.x0 = sharp->xoff + 2;
+	metrics.y0 = sharp->yoff + 2;
+	metrics.x1 = metrics.x0 + sw - 4;
+	metrics.y1 = metrics.y0 + sh - 4;
+	const short xadv = sharp->xadv;
+	GlyphValue* glyph = placeGlyph( font, GlyphKey{ codepoint, isize, iblur, phase }, 0, sharp->index, metrics, FONS_GLYPH_BITMAP_REQUIRED );
+	if( nullptr == glyph )
+		return nullptr;
+	glyph->xadv = xadv;
+
+	// Same pixels as rasterizing with the larger padding, the new rectangle is zeroed
+	pages[ glyph->page ].texture.writeRect( params.width, glyph->x0 + iblur, glyph->y0 + iblur, sw, sh, sharpPixels.data() );
+	commitGlyph( glyph, iblur );
+	return glyph;
+}
+
+bool Context::withinRasterBudget() const
+{
+	if( frameGlyphBudget > 0 && frameGlyphs >= frameGlyphBudget )
+		return false;
+	if( frameMicrosBudget > 0 && frameRasterNanos >= (int64_t)frameMicrosBudget * 1000 )
+		return false;
+	return true;
+}
+
+void Context::rememberSize( short isize )
+{
+	if( recentSizes[ 0 ] == isize )
+		return;
+	// Move to the front, the least recent one drops out when the size is new
+	int i = 0;
+	while( i < FONS_RECENT_SIZES - 1 && recentSizes[ i ] != isize )
+		i++;
+	for( ; i > 0; i-- )
+		recentSizes[ i ] = recentSizes[ i - 1 ];
+	recentSizes[ 0 ] = isize;
+}
+
+GlyphValue* Context::getGlyphForFrame( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, int bitmapOption, float& glyphScale )
+{
+	// Measuring only needs the metrics, they're cheap to load without the bitmap, and must not depend on the budget or the timing of the thread
+	if( ( !hasRasterBudget() && !asyncRaster ) || isize < 2 || bitmapOption != FONS_GLYPH_BITMAP_REQUIRED )
+		return getGlyph( font, codepoint, isize, iblur, phase, bitmapOption );
+
+	const GlyphKey key{ codepoint, isize, clampBlur( iblur ), phase };
+	const GlyphValue* cached = font.lookupGlyph( key );
+	if( nullptr != cached && cached->hasBitmap() )
 	{
-		for( int idxFallback : font.getFallbackFonts() )
+		rememberSize( isize );
+		return getGlyph( font, codepoint, isize, iblur, phase, bitmapOption );
+	}
+
+	if( asyncRaster )
+		submitAsyncGlyph( font, key );
+	else if( withinRasterBudget() )
+	{
+		const auto start = std::chrono::steady_clock::now();
+		GlyphValue* glyph = getGlyph( font, codepoint, isize, iblur, phase, bitmapOption );
+		frameRasterNanos += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+		frameGlyphs++;
+		if( nullptr != glyph )
+			rememberSize( isize );
+		return glyph;
+	}
+	else
+	{
+		uint8_t* queued = deferredKeys.insert( key.withFont( font.getIndex() ).bits );
+		if( 0 == *queued )
 		{
-			FONSfont* fallbackFont = fonts[ idxFallback ].get();
-			int fallbackIndex = fallbackFont->getGlyphIndex( codepoint );
-			if( fallbackIndex != 0 )
-			{
-				g = fallbackIndex;
-				renderFont = fallbackFont;
-				break;
-			}
+			*queued = 1;
+			deferredGlyphs.push_back( DeferredGlyph{ &font, key } );
+			atlasStats.glyphsDeferred++;
 		}
-		// It is possible that we did not find a fallback glyph.
-		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
 	}
-	const float scale = renderFont->getPixelHeightScale( size );
-	int advance, lsb, x0, y0, x1, y1;
-	renderFont->buildGlyphBitmap( g, size, &advance, &lsb, &x0, &y0, &x1, &y1 );
-	const int gw = x1 - x0 + pad * 2;
-	const int gh = y1 - y0 + pad * 2;
+	frameUnfinished++;
+
+	// The nearest recently drawn size which has the glyph, the blurred glyphs only substitute the same blur.
+	// At the same size, the glyph at a whole pixel substitutes the one at a subpixel phase.
+	GlyphValue* best = nullptr;
+	short bestSize = 0;
+	for( short size : recentSizes )
+	{
+		if( size < 2 || ( size == isize && 0 == key.phase() ) )
+			continue;
+		GlyphValue* glyph = font.lookupGlyph( GlyphKey{ codepoint, size, key.blur(), 0 } );
+		if( nullptr == glyph || !glyph->hasBitmap() )
+			continue;
+		if( nullptr == best || abs( size - isize ) < abs( bestSize - isize ) )
+		{
+			best = glyph;
+			bestSize = size;
+		}
+	}
+	const float textSize = ( glyphScale > 0 ? glyphScale : 1.0f ) * isize;
+	if( nullptr != best )
+	{
+		best->lastUsed = frame;
+		glyphScale = textSize / bestSize;
+		return best;
+	}
+
+	uint32_t* index = placeholderIndex.insert( key.withFont( font.getIndex() ).bits );
+	if( 0 != *index )
+		return &placeholders[ *index - 1 ];
+
+	// The empty 2x2 rectangle makes a quad of zero size, getQuad() insets the glyphs by a pixel
+	uint32_t g;
+	FONSfont* renderFont = resolveGlyphIndex( font, codepoint, g );
+	GlyphValue placeholder = {};
+	placeholder.index = g;
+	placeholder.x1 = 2;
+	placeholder.y1 = 2;
+	placeholder.xadv = (short)( renderFont->getPixelHeightScale( isize / 10.0f ) * renderFont->getGlyphAdvance( g ) * 10.0f );
+	placeholder.page = (unsigned short)drawPage;
+	placeholder.lastUsed = frame;
+	placeholders.push_back( placeholder );
+	*index = (uint32_t)placeholders.size();
+	return &placeholders.back();
+}
+
+void Context::finishDeferredGlyphs()
+{
+	if( deferredGlyphs.empty() )
+		return;
+	size_t done = 0;
+	for( ; done < deferredGlyphs.size() && withinRasterBudget(); done++ )
+	{
+		const DeferredGlyph& d = deferredGlyphs[ done ];
+		// Already rasterized when a frame had the budget for it
+		const GlyphValue* cached = d.font->lookupGlyph( d.key );
+		if( nullptr != cached && cached->hasBitmap() )
+			continue;
+		const auto start = std::chrono::steady_clock::now();
+		getGlyph( *d.font, d.key.codepoint(), d.key.size(), d.key.blur(), d.key.phase(), FONS_GLYPH_BITMAP_REQUIRED );
+		frameRasterNanos += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+		frameGlyphs++;
+	}
+	deferredGlyphs.erase( deferredGlyphs.begin(), deferredGlyphs.begin() + done );
+
+	// FlatMap has no erase, rebuild the set from the rest
+	deferredKeys.clear();
+	for( const DeferredGlyph& d : deferredGlyphs )
+		*deferredKeys.insert( d.key.withFont( d.font->getIndex() ).bits ) = 1;
+}
+
+bool Context::setAsyncRasterization( bool enabled )
+{
+	if( enabled && asyncRaster )
+		return true;
+	// Joins the thread, the glyphs in flight are dropped and submitted again when drawn
+	asyncRaster.reset();
+	asyncInFlight = 0;
+	asyncKeys.clear();
+	if( !enabled )
+		return true;
+	try
+	{
+		asyncRaster = std::make_unique<AsyncRasterizer>( FONS_ASYNC_GLYPHS );
+		return true;
+	}
+	catch( const std::exception& )
+	{
+		asyncRaster.reset();
+		return false;
+	}
+}
+
+void Context::submitAsyncGlyph( FONSfont& font, const GlyphKey& key )
+{
+	// The thread has room for that many results, the glyphs over it are submitted again when drawn in the next frames
+	if( asyncInFlight >= (int)asyncRaster->capacity() )
+		return;
+	uint8_t* queued = asyncKeys.insert( key.withFont( font.getIndex() ).bits );
+	if( 0 != *queued )
+		return;
+
+	uint32_t g;
+	const FONSfont* renderFont = resolveGlyphIndex( font, key.codepoint(), g );
+	RasterJob job;
+	job.font = renderFont;
+	job.glyph = g;
+	job.size = key.size() / 10.0f;
+	job.codepoint = key.codepoint();
+	job.cacheFont = &font;
+	job.isize = key.size();
+	job.iblur = key.blur();
+	job.phase = key.phase();
+	job.ok = false;
+	if( !asyncRaster->submit( std::move( job ) ) )
+		return;
+	*queued = 1;
+	asyncInFlight++;
+	atlasStats.glyphsDeferred++;
+}
+
+void Context::collectAsyncGlyphs()
+{
+	if( !asyncRaster )
+		return;
+	RasterJob job;
+	bool atlasFull = false;
+	while( asyncRaster->takeResult( job ) )
+	{
+		asyncInFlight--;
+		const GlyphKey key{ job.codepoint, job.isize, job.iblur, job.phase };
+		*asyncKeys.find( key.withFont( job.cacheFont->getIndex() ).bits ) = 0;
+
+		// Prewarming could render it meanwhile. Over the capacity of the atlas, the rest are dropped, and submitted again when drawn.
+		const GlyphValue* cached = job.cacheFont->lookupGlyph( key );
+		if( ( nullptr != cached && cached->hasBitmap() ) || atlasFull )
+			continue;
+		if( !job.ok )
+		{
+			// The thread failed to load the font, render it on this thread
+			if( nullptr == getGlyph( *job.cacheFont, job.codepoint, job.isize, job.iblur, job.phase, FONS_GLYPH_BITMAP_REQUIRED ) )
+				atlasFull = true;
+			continue;
+		}
+		GlyphValue* glyph = placeGlyph( *job.cacheFont, key, job.font->getPixelHeightScale( job.size ), job.glyph, job.bitmap.metrics, FONS_GLYPH_BITMAP_REQUIRED );
+		if( nullptr == glyph )
+		{
+			atlasFull = true;
+			continue;
+		}
+		pages[ glyph->page ].texture.addGlyph( job.bitmap, params.width, glyph, job.iblur + 2 );
+		commitGlyph( glyph, job.iblur );
+	}
+	if( 0 == asyncInFlight )
+		asyncKeys.clear();
+}
+
+GlyphValue* Context::getDistanceFieldGlyph( FONSfont& font, unsigned int codepoint, int bitmapOption )
+{
+	const short isize = (short)( distanceFieldSize * 10.0f );
+	const short spread = (short)distanceFieldSpread;
+	const GlyphKey key{ codepoint, isize, spread, GlyphKey::distanceField };
+	GlyphValue* glyph = font.lookupGlyph( key );
+	if( nullptr != glyph )
+	{
+		if( bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL )
+			return glyph;
+		if( glyph->hasBitmap() )
+		{
+			glyph->lastUsed = frame;
+			return glyph;
+		}
+	}
+
+	// placeGlyph pads the coverage by the spread from the key, the field fills the padding except the usual 2 pixels
+	uint32_t g;
+	FONSfont* renderFont = resolveGlyphIndex( font, codepoint, g );
+	const float size = isize / 10.0f;
+	renderFont->buildCoverage( g, size, fieldCoverage );
+	glyph = placeGlyph( font, key, renderFont->getPixelHeightScale( size ), g, fieldCoverage.metrics, bitmapOption );
+	if( nullptr == glyph || bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL )
+		return glyph;
+
+	if( fieldCoverage.pitch > 0 && fieldCoverage.rows > 0 )
+	{
+		const int fw = fieldCoverage.pitch + spread * 2;
+		const int fh = fieldCoverage.rows + spread * 2;
+		fieldPixels.resize( (size_t)fw * fh );
+		buildDistanceField( fieldCoverage.pixels.data(), fieldCoverage.pitch, fieldCoverage.rows, fieldCoverage.pitch, spread, fieldPixels.data(), fw, fieldScratch );
+		pages[ glyph->page ].texture.writeGrayRect( params.width, glyph->x0 + 2, glyph->y0 + 2, fw, fh, fieldPixels.data() );
+	}
+	// No blur, the blur byte of the key is the spread
+	commitGlyph( glyph, 0 );
+	return glyph;
+}
+
+GlyphValue* Context::placeGlyph( FONSfont& font, const GlyphKey& key, float scale, uint32_t glyphIndex, const GlyphMetrics& metrics, int bitmapOption )
+{
+	const int pad = key.blur() + 2;
+	const int gw = metrics.x1 - metrics.x0 + pad * 2;
+	const int gh = metrics.y1 - metrics.y0 + pad * 2;
 
 	// Determines the spot to draw glyph in the atlas.
 	int gx, gy;
+	int page = 0;
 	if( bitmapOption == FONS_GLYPH_BITMAP_REQUIRED )
 	{
-		// Find free spot for the rect in the atlas
-		bool added = atlas.addRect( gw, gh, &gx, &gy );
-		if( !added && handleError != NULL )
+		// Find free spot for the rect in the atlas, adding pages up to the limit
+		page = addRect( gw, gh, &gx, &gy );
+		if( page < 0 && evictGlyphs( gw, gh ) )
+			page = addRect( gw, gh, &gx, &gy );
+		if( page < 0 && handleError != NULL )
 		{
 			// Atlas is full, let the user to resize the atlas (or not), and try again.
 			handleError( errorUptr, FONS_ATLAS_FULL, 0 );
-			added = atlas.addRect( gw, gh, &gx, &gy );
+			page = addRect( gw, gh, &gx, &gy );
 		}
-		if( !added )
+		if( page < 0 )
 			return NULL;
+		liveArea += gw * gh;
 	}
 	else
 	{
@@ -195,51 +639,425 @@ GlyphValue* Context::getGlyph( FONSfont& font, unsigned int codepoint, short isi
 		gy = -1;
 	}
 
-	// Init glyph.
-	if( glyph == NULL )
-		glyph = font.allocGlyph( codepoint, isize, iblur );
+	// Init glyph, or find the cached one without the bitmap.
+	GlyphValue* glyph = font.allocGlyph( key );
 
-	glyph->index = g;
+	glyph->index = glyphIndex;
 	glyph->x0 = (short)gx;
 	glyph->y0 = (short)gy;
 	glyph->x1 = (short)( glyph->x0 + gw );
 	glyph->y1 = (short)( glyph->y0 + gh );
-	glyph->xadv = (short)( scale * advance * 10.0f );
-	glyph->xoff = (short)( x0 - pad );
-	glyph->yoff = (short)( y0 - pad );
+	glyph->xadv = (short)( scale * metrics.advance * 10.0f );
+	glyph->xoff = (short)( metrics.x0 - pad );
+	glyph->yoff = (short)( metrics.y0 - pad );
+	glyph->page = (unsigned short)page;
+	glyph->lastUsed = frame;
+	return glyph;
+}
 
-	if( bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL )
-		return glyph;
+bool Context::evictGlyphs( int w, int h )
+{
+	struct Candidate
+	{
+		uint32_t lastUsed;
+		GlyphValue* glyph;
+	};
+	std::vector<Candidate> candidates;
+	for( auto& f : fonts )
+	{
+		f->forEachGlyph( [ & ]( GlyphKey, GlyphValue& value )
+		{
+			if( value.hasBitmap() && value.lastUsed != frame )
+				candidates.push_back( Candidate{ value.lastUsed, &value } );
+		} );
+	}
+	if( candidates.empty() )
+		return false;
+	std::stable_sort( candidates.begin(), candidates.end(), []( const Candidate& a, const Candidate& b ) { return a.lastUsed < b.lastUsed; } );
 
-	// Rasterize
-	ramTexture.addGlyph( font, params.width, glyph, pad );
+	atlasStats.evictionPasses++;
+	bool fits = false;
+	for( size_t i = 0; i < candidates.size(); i++ )
+	{
+		// Keep the metrics, the glyph stays in the cache without the bitmap, same as FONS_GLYPH_BITMAP_OPTIONAL glyphs
+		GlyphValue& g = *candidates[ i ].glyph;
+		const int gw = g.x1 - g.x0;
+		const int gh = g.y1 - g.y0;
+		// Zero the pixels, new glyphs only write their bitmap and the 1 pixel border, and the blur reads the complete rectangle
+		AtlasPage& page = pages[ g.page ];
+		page.texture.clearRect( params.width, g.x0, g.y0, gw, gh );
+		page.atlas.freeRect( g.x0, g.y0, gw, gh );
+		liveArea -= gw * gh;
+		g.x0 = -1;
+		g.y0 = -1;
+		g.x1 = (short)( g.x0 + gw );
+		g.y1 = (short)( g.y0 + gh );
+		atlasStats.glyphsEvicted++;
+
+		if( !fits )
+			fits = page.atlas.hasFreeRect( w, h );
+		if( fits && i + 1 >= FONS_EVICT_MIN_GLYPHS )
+			break;
+	}
+	return fits;
+}
+
+float Context::getAtlasFragmentation() const
+{
+	int used = 0;
+	for( const AtlasPage& page : pages )
+		used += params.width * params.height - page.atlas.getOpenArea();
+	if( used <= 0 )
+		return 0;
+	return 1.0f - (float)liveArea / (float)used;
+}
+
+bool Context::compactAtlas()
+{
+	flush();
+
+	struct Item
+	{
+		GlyphValue* glyph;
+		int width, height;
+	};
+	std::vector<Item> items;
+	for( auto& f : fonts )
+	{
+		f->forEachGlyph( [ & ]( GlyphKey, GlyphValue& value )
+		{
+			if( value.hasBitmap() )
+				items.push_back( Item{ &value, value.x1 - value.x0, value.y1 - value.y0 } );
+		} );
+	}
+	// Tallest first, both packers waste the least space when the heights of the neighbors are similar
+	std::stable_sort( items.begin(), items.end(), []( const Item& a, const Item& b )
+	{
+		if( a.height != b.height )
+			return a.height > b.height;
+		return a.width > b.width;
+	} );
+
+	// Pack into new pages, never more than the current count. The old pages keep the pixels until all of them are copied.
+	const bool shelves = packer == FONS_PACKER_SHELF;
+	std::vector<AtlasPage> packed;
+	struct Position
+	{
+		int page, x, y;
+	};
+	std::vector<Position> positions( items.size() );
+	try
+	{
+		packed.emplace_back( params.width, params.height, FONS_INIT_ATLAS_NODES, shelves );
+		// The white rect is the first one, at 0,0 same as after reset
+		int wx, wy;
+		if( !packed[ 0 ].atlas.addRect( 2, 2, &wx, &wy ) )
+			return false;
+		for( size_t i = 0; i < items.size(); i++ )
+		{
+			Position& pos = positions[ i ];
+			pos.page = 0;
+			while( !packed[ pos.page ].atlas.addRect( items[ i ].width, items[ i ].height, &pos.x, &pos.y ) )
+			{
+				if( ++pos.page < (int)packed.size() )
+					continue;
+				if( packed.size() >= pages.size() )
+					return false;
+				packed.emplace_back( params.width, params.height, FONS_INIT_ATLAS_NODES, shelves );
+			}
+		}
+		for( AtlasPage& page : packed )
+			if( !page.texture.resize( params.width, params.height ) )
+				return false;
+	}
+	catch( const std::exception& )
+	{
+		return false;
+	}
+
+	// Move the pixels with the padding, the blurred glyphs don't need the blur again
+	packed[ 0 ].texture.addWhiteRect( params.width, 0, 0, 2, 2 );
+	int area = 4;
+	for( size_t i = 0; i < items.size(); i++ )
+	{
+		GlyphValue& g = *items[ i ].glyph;
+		const Position& pos = positions[ i ];
+		const int gw = items[ i ].width;
+		const int gh = items[ i ].height;
+		packed[ pos.page ].texture.copyRect( pages[ g.page ].texture, params.width, g.x0, g.y0, gw, gh, pos.x, pos.y );
+		g.x0 = (short)pos.x;
+		g.y0 = (short)pos.y;
+		g.x1 = (short)( pos.x + gw );
+		g.y1 = (short)( pos.y + gh );
+		g.page = (unsigned short)pos.page;
+		area += gw * gh;
+	}
+
+	// A single update per page, covering the old content which is now zeroed
+	for( size_t i = 0; i < packed.size(); i++ )
+		packed[ i ].setDirty( 0, 0, params.width, std::max( std::max( packed[ i ].atlas.getMaxY(), pages[ i ].atlas.getMaxY() ), 1 ) );
+	pages.swap( packed );
+	liveArea = area;
+	evictedAtCompaction = atlasStats.glyphsEvicted;
+	atlasStats.compactions++;
+	return true;
+}
+
+void Context::compactIfFragmented()
+{
+	if( compactThreshold <= 0 || atlasStats.glyphsEvicted == evictedAtCompaction )
+		return;
+	if( getAtlasFragmentation() <= compactThreshold )
+		return;
+	if( !compactAtlas() )
+	{
+		// Don't retry every frame, wait for more evictions
+		evictedAtCompaction = atlasStats.glyphsEvicted;
+	}
+}
 
-#ifndef NANOVG_CLEARTYPE
+void Context::commitGlyph( const GlyphValue* glyph, short iblur )
+{
 	// Blur
 	if( iblur > 0 )
 	{
-		scratch.clear();
-		ramTexture.blurRectangle( params.width, glyph->x0, glyph->y0, gw, gh, iblur );
+		pages[ glyph->page ].texture.blurRectangle( params.width, glyph->x0, glyph->y0, glyph->x1 - glyph->x0, glyph->y1 - glyph->y0, iblur, blurScratch );
 	}
-#endif
 
-	dirtyRect[ 0 ] = std::min( dirtyRect[ 0 ], (int)glyph->x0 );
-	dirtyRect[ 1 ] = std::min( dirtyRect[ 1 ], (int)glyph->y0 );
-	dirtyRect[ 2 ] = std::max( dirtyRect[ 2 ], (int)glyph->x1 );
-	dirtyRect[ 3 ] = std::max( dirtyRect[ 3 ], (int)glyph->y1 );
+	pages[ glyph->page ].addDirty( glyph->x0, glyph->y0, glyph->x1, glyph->y1 );
+}
 
-	return glyph;
+bool Context::setRasterThreads( int count )
+{
+	rasterJobs.clear();
+	rasterKeys.clear();
+	if( count <= 1 )
+	{
+		rasterPool.reset();
+		return true;
+	}
+	if( rasterPool && rasterPool->threadsCount() == count )
+		return true;
+	try
+	{
+		rasterPool.reset();
+		rasterPool = std::make_unique<RasterPool>( count );
+		return true;
+	}
+	catch( const std::exception& )
+	{
+		rasterPool.reset();
+		return false;
+	}
+}
+
+void Context::queueGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, bool skipMissing )
+{
+	iblur = clampBlur( iblur );
+	if( isize < 2 )
+		return;
+	const GlyphKey key{ codepoint, isize, iblur, phase };
+	const GlyphValue* cached = font.lookupGlyph( key );
+	if( nullptr != cached && cached->hasBitmap() )
+		return;
+	uint8_t* queued = rasterKeys.insert( key.bits );
+	if( 0 != *queued )
+		return;
+	*queued = 1;
+
+	uint32_t g;
+	const FONSfont* renderFont = resolveGlyphIndex( font, codepoint, g );
+	if( skipMissing && 0 == g )
+		return;
+
+	rasterJobs.emplace_back();
+	RasterJob& job = rasterJobs.back();
+	job.font = renderFont;
+	job.glyph = g;
+	job.size = isize / 10.0f;
+	job.codepoint = codepoint;
+	job.cacheFont = &font;
+	job.isize = isize;
+	job.iblur = iblur;
+	job.phase = phase;
+	job.ok = false;
+}
+
+int Context::flushRasterJobs( FONSfont& font, bool& atlasFull )
+{
+	int added = 0;
+	if( !rasterJobs.empty() )
+	{
+		rasterPool->run( rasterJobs );
+
+		for( const RasterJob& job : rasterJobs )
+		{
+			// The failed ones are left for getGlyph(), it will retry on the calling thread
+			if( !job.ok )
+				continue;
+			const GlyphKey key{ job.codepoint, job.isize, job.iblur, job.phase };
+			GlyphValue* glyph = placeGlyph( font, key, job.font->getPixelHeightScale( job.size ), job.glyph, job.bitmap.metrics, FONS_GLYPH_BITMAP_REQUIRED );
+			if( nullptr == glyph )
+			{
+				atlasFull = true;
+				break;
+			}
+			pages[ glyph->page ].texture.addGlyph( job.bitmap, params.width, glyph, job.iblur + 2 );
+			commitGlyph( glyph, job.iblur );
+			added++;
+		}
+	}
+	rasterJobs.clear();
+	rasterKeys.clear();
+	return added;
+}
+
+void Context::prefetchGlyphs( FONSfont& font, const char* str, const char* end, short isize, short iblur )
+{
+	if( !rasterPool || subpixelPhases > 1 || hasRasterBudget() || asyncRaster )
+		return;
+
+	unsigned int utf8state = 0, codepoint;
+	bool atlasFull = false;
+	for( ; str != end; ++str )
+	{
+		if( decodeUTF8( &utf8state, &codepoint, *(const unsigned char*)str ) )
+			continue;
+		queueGlyph( font, codepoint, isize, iblur, 0, false );
+		if( rasterJobs.size() >= FONS_MAX_PARALLEL_GLYPHS )
+		{
+			flushRasterJobs( font, atlasFull );
+			if( atlasFull )
+				return;
+		}
+	}
+
+	if( rasterJobs.size() >= FONS_MIN_PARALLEL_GLYPHS )
+		flushRasterJobs( font, atlasFull );
+	else
+	{
+		// Too few, getGlyph() will render them on this thread
+		rasterJobs.clear();
+		rasterKeys.clear();
+	}
+}
+
+bool Context::prewarmGlyphs( FONSfont& font, const FONSstate& state, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, FONSprewarmStats& stats )
+{
+	if( state.distanceField )
+		return prewarmDistanceField( font, ranges, nranges, stats );
+
+	const short iblur = (short)state.blur;
+	bool atlasFull = false;
+	for( int s = 0; s < nsizes; s++ )
+	{
+		// The size the text drawn with the state rasterizes, the first frames draw the bucket before the size settles
+		FONSstate sizeState = state;
+		sizeState.size = sizes[ s ];
+		short isize;
+		const float glyphScale = getGlyphScale( sizeState, isize, false );
+		// The scaled glyphs are drawn at phase 0 only
+		const int phases = 0 == glyphScale ? subpixelPhases : 1;
+		for( int r = 0; r < nranges; r++ )
+		{
+			for( uint64_t cp = ranges[ r * 2 ]; cp <= ranges[ r * 2 + 1 ]; cp++ )
+			{
+				const unsigned int codepoint = (unsigned int)cp;
+				for( int p = 0; p < phases; p++ )
+				{
+					const short phase = (short)( p * GlyphKey::phaseSteps / subpixelPhases );
+					if( rasterPool )
+					{
+						queueGlyph( font, codepoint, isize, iblur, phase, true );
+						if( rasterJobs.size() >= FONS_MAX_PARALLEL_GLYPHS )
+						{
+							stats.added += flushRasterJobs( font, atlasFull );
+							if( atlasFull )
+							{
+								stats.atlasFull = 1;
+								return false;
+							}
+						}
+						continue;
+					}
+
+					const GlyphValue* cached = font.lookupGlyph( GlyphKey{ codepoint, isize, clampBlur( iblur ), phase } );
+					if( nullptr != cached && cached->hasBitmap() )
+						continue;
+
+					// Don't waste atlas space on the "missing glyph" boxes for the codepoints none of the fonts have
+					uint32_t g;
+					resolveGlyphIndex( font, codepoint, g );
+					if( 0 == g )
+						break;
+
+					if( nullptr == getGlyph( font, codepoint, isize, iblur, phase, FONS_GLYPH_BITMAP_REQUIRED ) )
+					{
+						stats.atlasFull = 1;
+						return false;
+					}
+					stats.added++;
+				}
+			}
+		}
+	}
+
+	if( rasterPool )
+	{
+		stats.added += flushRasterJobs( font, atlasFull );
+		if( atlasFull )
+		{
+			stats.atlasFull = 1;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Context::prewarmDistanceField( FONSfont& font, const unsigned int* ranges, int nranges, FONSprewarmStats& stats )
+{
+	// A single glyph per codepoint serves all sizes, the key is the one getDistanceFieldGlyph() uses
+	const short isize = (short)( distanceFieldSize * 10.0f );
+	const short spread = (short)distanceFieldSpread;
+	for( int r = 0; r < nranges; r++ )
+	{
+		for( uint64_t cp = ranges[ r * 2 ]; cp <= ranges[ r * 2 + 1 ]; cp++ )
+		{
+			const unsigned int codepoint = (unsigned int)cp;
+			const GlyphValue* cached = font.lookupGlyph( GlyphKey{ codepoint, isize, spread, GlyphKey::distanceField } );
+			if( nullptr != cached && cached->hasBitmap() )
+				continue;
+
+			uint32_t g;
+			resolveGlyphIndex( font, codepoint, g );
+			if( 0 == g )
+				continue;
+
+			if( nullptr == getDistanceFieldGlyph( font, codepoint, FONS_GLYPH_BITMAP_REQUIRED ) )
+			{
+				stats.atlasFull = 1;
+				return false;
+			}
+			stats.added++;
+		}
+	}
+	return true;
 }
 
 void Context::getQuad( FONSfont& font, int prevGlyphIndex, GlyphValue* glyph,
-	float scale, float spacing, float* x, float* y, FONSquad* q )
+	float scale, float spacing, float glyphScale, float* x, float* y, FONSquad* q )
 {
 	float rx, ry, xoff, yoff, x0, y0, x1, y1;
 
+	const bool subpixel = subpixelPhases > 1;
+	const bool scaled = glyphScale > 0;
 	if( prevGlyphIndex != -1 )
 	{
 		float adv = font.getGlyphKernAdvance( prevGlyphIndex, glyph->index ) * scale;
-		*x += (int)( adv + spacing + 0.5f );
+		if( subpixel || scaled )
+			*x += adv + spacing;
+		else
+			*x += (int)( adv + spacing + 0.5f );
 	}
 
 	// Each glyph has 2px border to allow good interpolation,
@@ -252,15 +1070,45 @@ void Context::getQuad( FONSfont& font, int prevGlyphIndex, GlyphValue* glyph,
 	x1 = (float)( glyph->x1 - 1 );
 	y1 = (float)( glyph->y1 - 1 );
 
-	if( params.flags & FONS_ZERO_TOPLEFT )
+	q->s0 = x0 * itw;
+	q->t0 = y0 * ith;
+	q->s1 = x1 * itw;
+	q->t1 = y1 * ith;
+
+	if( scaled )
+	{
+		// The metrics are in pixels of the size the glyph was rasterized at, the texture filtering smooths the fractional positions
+		q->x0 = *x + xoff * glyphScale;
+		q->x1 = q->x0 + ( x1 - x0 ) * glyphScale;
+		if( params.flags & FONS_ZERO_TOPLEFT )
+		{
+			q->y0 = *y + yoff * glyphScale;
+			q->y1 = q->y0 + ( y1 - y0 ) * glyphScale;
+		}
+		else
+		{
+			q->y0 = *y - yoff * glyphScale;
+			q->y1 = q->y0 - ( y1 - y0 ) * glyphScale;
+		}
+		*x += glyph->xadv / 10.0f * glyphScale;
+		return;
+	}
+
+	if( subpixel )
 	{
+		// The bitmap is shifted by the phase selected by getSubpixelPhase, the rest of the position is whole pixels
+		const float steps = floorf( *x * subpixelPhases + 0.5f );
+		rx = floorf( steps / subpixelPhases ) + xoff;
+	}
+	else
 		rx = (float)(int)( *x + xoff );
+	if( params.flags & FONS_ZERO_TOPLEFT )
+	{
 		ry = (float)(int)( *y + yoff );
 		q->y1 = ry + y1 - y0;
 	}
 	else
 	{
-		rx = (float)(int)( *x + xoff );
 		ry = (float)(int)( *y - yoff );
 		q->y1 = ry - y1 + y0;
 	}
@@ -268,26 +1116,84 @@ void Context::getQuad( FONSfont& font, int prevGlyphIndex, GlyphValue* glyph,
 	q->y0 = ry;
 	q->x1 = rx + x1 - x0;
 
-	q->s0 = x0 * itw;
-	q->t0 = y0 * ith;
-	q->s1 = x1 * itw;
-	q->t1 = y1 * ith;
+	if( subpixel )
+		*x += glyph->xadv / 10.0f;
+	else
+		*x += (int)( glyph->xadv / 10.0f + 0.5f );
+}
+
+float Context::getGlyphScale( const FONSstate& state, short& glyphSize, bool drawing )
+{
+	const short isize = (short)( state.size * 10.0f );
+	glyphSize = isize;
+	if( state.distanceField )
+		return state.size / distanceFieldSize;
+	if( sizeBucketRatio <= 1 || isSizeSettled( isize, drawing ) )
+		return 0;
+
+	const float step = logf( sizeBucketRatio );
+	const float bucket = expf( roundf( logf( isize / 10.0f ) / step ) * step );
+	const short bucketSize = (short)( bucket * 10.0f + 0.5f );
+	if( bucketSize == isize || bucketSize < 2 )
+		return 0;
+	glyphSize = bucketSize;
+	return (float)isize / (float)bucketSize;
+}
 
-	*x += (int)( glyph->xadv / 10.0f + 0.5f );
+bool Context::isSizeSettled( short isize, bool drawing )
+{
+	if( sizeSettleFrames <= 0 )
+		return false;
+	if( !drawing )
+	{
+		// Same answer as drawing the size now, when the streak is alive
+		for( const SizeStreak& s : sizeStreaks )
+			if( s.isize == isize && s.last + 1 >= frame )
+				return frame - s.first >= (uint32_t)sizeSettleFrames;
+		return false;
+	}
+	// Sizes not drawn in this or the previous frame broke their streak
+	sizeStreaks.erase( std::remove_if( sizeStreaks.begin(), sizeStreaks.end(), [ this ]( const SizeStreak& s ) { return s.last + 1 < frame; } ), sizeStreaks.end() );
+	for( SizeStreak& s : sizeStreaks )
+	{
+		if( s.isize == isize )
+		{
+			s.last = frame;
+			return frame - s.first >= (uint32_t)sizeSettleFrames;
+		}
+	}
+	sizeStreaks.push_back( SizeStreak{ isize, frame, frame } );
+	return false;
+}
+
+short Context::getSubpixelPhase( FONSfont& font, int prevGlyphIndex, unsigned int codepoint, float scale, float spacing, float x )
+{
+	if( subpixelPhases <= 1 )
+		return 0;
+	// Same pen position as getQuad() computes after the kerning, glyph->index is the index resolved here
+	if( prevGlyphIndex != -1 )
+	{
+		uint32_t g;
+		resolveGlyphIndex( font, codepoint, g );
+		float adv = font.getGlyphKernAdvance( prevGlyphIndex, g ) * scale;
+		x += adv + spacing;
+	}
+	const int steps = (int)floorf( x * subpixelPhases + 0.5f );
+	return (short)( ( steps & ( subpixelPhases - 1 ) ) * ( GlyphKey::phaseSteps / subpixelPhases ) );
 }
 
 void Context::flush()
 {
-	// Flush texture
-	if( dirtyRect[ 0 ] < dirtyRect[ 2 ] && dirtyRect[ 1 ] < dirtyRect[ 3 ] )
+	// Flush texture. The callback has no page argument, it only receives the first page, the other ones are pulled with fonsValidatePage.
+	if( pages[ 0 ].isDirty() )
 	{
+		int rects[ FONS_MAX_DIRTY_RECTS * 4 ];
+		const int count = takeDirtyRects( 0, rects, FONS_MAX_DIRTY_RECTS );
 		if( params.renderUpdate != NULL )
-			params.renderUpdate( params.userPtr, dirtyRect, (const uint8_t*)ramTexture.data() );
-		// Reset dirty rect
-		dirtyRect[ 0 ] = params.width;
-		dirtyRect[ 1 ] = params.height;
-		dirtyRect[ 2 ] = 0;
-		dirtyRect[ 3 ] = 0;
+		{
+			for( int i = 0; i < count; i++ )
+				params.renderUpdate( params.userPtr, rects + i * 4, (const uint8_t*)pages[ 0 ].texture.data() );
+		}
 	}
 
 	// Flush triangles
@@ -299,6 +1205,18 @@ void Context::flush()
 	}
 }
 
+int Context::takeDirtyRects( int page, int* rects, int maxRects )
+{
+	const int count = pages[ page ].takeDirty( rects, maxRects );
+	for( int i = 0; i < count; i++ )
+	{
+		const int* r = rects + i * 4;
+		atlasStats.frameUploadBytes += ( r[ 2 ] - r[ 0 ] ) * ( r[ 3 ] - r[ 1 ] ) * (int)sizeof( *pages[ page ].texture.data() );
+	}
+	atlasStats.uploads += count;
+	return count;
+}
+
 void Context::vertex( float x, float y, float s, float t, unsigned int c )
 {
 	verts[ nverts * 2 + 0 ] = x;
@@ -2,5 +2,5 @@
 
 int FontStash2::Context::debugDumpAtlas( const char* path ) const
 {
-	return ramTexture.save( params.width, params.height, path );
+	return pages[ 0 ].texture.save( params.width, params.height, path );
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include <memory>
-#include "Atlas.h"
+#include <deque>
+#include "AtlasPage.h"
 #include "Font.h"
-#include "RamTexture.h"
+#include "RasterPool.h"
+#include "AsyncRasterizer.h"
+#include "distanceField.h"
 #include "../fontstash.h"
 
 #ifndef FONS_SCRATCH_BUF_SIZE
@@ -28,6 +31,37 @@
 #ifndef FONS_MAX_FALLBACKS
 #	define FONS_MAX_FALLBACKS 20
 #endif
+// Text runs with fewer missing glyphs are rendered on the calling thread, the synchronization costs more than it saves
+#ifndef FONS_MIN_PARALLEL_GLYPHS
+#	define FONS_MIN_PARALLEL_GLYPHS 8
+#endif
+// Minimum count of glyphs to evict at once when the atlas is full. Finding the least recently used ones scans all glyphs, evicting a few more amortizes the scan.
+#ifndef FONS_EVICT_MIN_GLYPHS
+#	define FONS_EVICT_MIN_GLYPHS 32
+#endif
+// Maximum count of glyphs in a single batch of the worker threads, limits memory used by the rendered bitmaps
+#ifndef FONS_MAX_PARALLEL_GLYPHS
+#	define FONS_MAX_PARALLEL_GLYPHS 1024
+#endif
+// Upper limit for fonsSetMaxAtlasPages, every page is a separate texture of the full atlas size
+#ifndef FONS_MAX_ATLAS_PAGES
+#	define FONS_MAX_ATLAS_PAGES 16
+#endif
+// Count of the recently drawn sizes searched for a substitute of a glyph deferred by the rasterization budget
+#ifndef FONS_RECENT_SIZES
+#	define FONS_RECENT_SIZES 8
+#endif
+// Capacity of the queues of the background rasterization thread, the most glyphs in flight at once
+#ifndef FONS_ASYNC_GLYPHS
+#	define FONS_ASYNC_GLYPHS 1024
+#endif
+// Reference size of the distance field glyphs in pixels, and how far the field extends outside of the outline
+#ifndef FONS_DISTANCE_FIELD_SIZE
+#	define FONS_DISTANCE_FIELD_SIZE 32
+#endif
+#ifndef FONS_DISTANCE_FIELD_SPREAD
+#	define FONS_DISTANCE_FIELD_SPREAD 4
+#endif
 
 namespace FontStash2
 {
@@ -39,6 +73,8 @@ namespace FontStash2
 		unsigned int color;
 		float blur;
 		float spacing;
+		// Non-zero to draw with the distance field glyphs
+		int distanceField;
 	};
 
 	class Context
@@ -47,21 +83,90 @@ namespace FontStash2
 		FONSparams params;
 		float itw, ith;
 
-#ifdef NANOVG_CLEARTYPE
-		RamTexture<uint32_t> ramTexture;
-#else
-		RamTexture<uint8_t> ramTexture;
-#endif
-		int dirtyRect[ 4 ];
+		// Pages of the atlas, all of them have the same size, params.width * params.height. There's always at least 1 page.
+		std::vector<AtlasPage> pages;
+		// The atlas grows up to that many pages before evicting glyphs
+		int maxPages = 1;
+		// Page of the vertices buffered for renderDraw callback
+		int drawPage = 0;
+		// FONSatlasPacker value, the allocator of all pages
+		int packer = FONS_PACKER_SKYLINE;
+		// Area of the rectangles with pixels on all pages, the glyphs with bitmaps and the white rect
+		int liveArea = 0;
+		// fonsNextFrame compacts the atlas when getAtlasFragmentation() is above that, 0 disables
+		float compactThreshold = 0;
+		// atlasStats.glyphsEvicted after the last compaction, only the evictions make new holes
+		int evictedAtCompaction = 0;
+		// Horizontal subpixel positions of the glyphs: 1, 2, 4 or 8. With 1, the glyphs are placed at whole pixels and the advances are rounded.
+		int subpixelPhases = 1;
+		// The distance field glyphs are rendered once at this size in pixels, and scaled to the size of the text
+		float distanceFieldSize = FONS_DISTANCE_FIELD_SIZE;
+		int distanceFieldSpread = FONS_DISTANCE_FIELD_SPREAD;
+		// Above 1, the glyphs are rasterized at the nearest size of a geometric ladder with that ratio between the steps, and their quads are scaled.
+		// Animated sizes then rasterize a bounded set of sizes. 0 disables.
+		float sizeBucketRatio = 0;
+		// A size drawn in more than that many consecutive frames is rasterized exactly, 0 keeps it in the bucket
+		int sizeSettleFrames = 0;
+		struct SizeStreak
+		{
+			short isize;
+			uint32_t first, last;
+		};
+		// Recently drawn sizes, and the frames when their streak of consecutive frames started and ended
+		std::vector<SizeStreak> sizeStreaks;
+
+		// Glyphs rasterized per frame before the rest are deferred, and the time for them in microseconds, 0 is no limit
+		int frameGlyphBudget = 0;
+		int frameMicrosBudget = 0;
+		// Glyphs rasterized and the time spent since fonsNextFrame
+		int frameGlyphs = 0;
+		int64_t frameRasterNanos = 0;
+		struct DeferredGlyph
+		{
+			FONSfont* font;
+			GlyphKey key;
+		};
+		// Glyphs over the budget, oldest first, rasterized by the following fonsNextFrame calls.
+		// The set has their GlyphKey::withFont() keys, to skip duplicates.
+		std::vector<DeferredGlyph> deferredGlyphs;
+		FlatMap<uint8_t> deferredKeys;
+		// Sizes of the glyphs drawn recently, most recent first, for the substitutes of the deferred glyphs
+		short recentSizes[ FONS_RECENT_SIZES ] = {};
+		// Returned instead of the deferred glyphs without a substitute: the advance, and an empty quad.
+		// One per glyph, the deque keeps the pointers valid until fonsNextFrame clears them. The map has 1-based indices by GlyphKey::withFont() keys.
+		std::deque<GlyphValue> placeholders;
+		FlatMap<uint32_t> placeholderIndex;
 		std::vector<std::unique_ptr<FontStash2::Font>> fonts;
-		FontStash2::Atlas atlas;
+
+		// Worker threads for batch rasterization, nullptr when disabled. Declared after the fonts, the workers have faces over their data.
+		std::unique_ptr<RasterPool> rasterPool;
+		// Glyphs queued for the workers, and keys of them to skip duplicates
+		std::vector<RasterJob> rasterJobs;
+		FlatMap<uint8_t> rasterKeys;
+		// Background rasterization thread, nullptr when disabled. Also declared after the fonts.
+		std::unique_ptr<AsyncRasterizer> asyncRaster;
+		// Glyphs submitted to the thread and not collected yet, and the set of their GlyphKey::withFont() keys, with 0 values for the collected ones
+		int asyncInFlight = 0;
+		FlatMap<uint8_t> asyncKeys;
+		// Glyphs drawn since fonsNextFrame with a substitute or the placeholder, because they were deferred or are still on the thread
+		int frameUnfinished = 0;
+
+		// Incremented by fonsNextFrame(), glyphs used in the current frame are never evicted
+		uint32_t frame = 1;
+		FONSatlasStats atlasStats = {};
 
 		float verts[ FONS_VERTEX_COUNT * 2 ];
 		float tcoords[ FONS_VERTEX_COUNT * 2 ];
 		unsigned int colors[ FONS_VERTEX_COUNT ];
 		int nverts = 0;
 
-		std::vector<uint8_t> scratch;
+		BlurScratch blurScratch;
+		// Pixels of the sharp glyph copied by deriveBlurredGlyph
+		std::vector<AtlasPage::Texel> sharpPixels;
+		// Buffers of getDistanceFieldGlyph
+		GlyphBitmap fieldCoverage;
+		std::vector<uint8_t> fieldPixels;
+		DistanceFieldScratch fieldScratch;
 		FONSstate states[ FONS_MAX_STATES ];
 		int nstates = 0;
 		void( *handleError )( void* uptr, int error, int val );
@@ -69,6 +174,34 @@ namespace FontStash2
 
 		void addWhiteRect( int w, int h );
 
+		// Append an empty page to the atlas, returns false if the limit is reached or out of memory
+		bool addPage();
+
+		// Find space for the rectangle on any page of the atlas, adding pages when they are full. Returns page index, or -1 if none of the pages fit the rectangle.
+		int addRect( int w, int h, int* x, int* y );
+
+		// Drop all pages except the first one, and all cached glyphs
+		bool resetAtlas( int width, int height );
+
+		// Grow all pages, keeping the glyphs
+		bool expandAtlas( int width, int height );
+
+		// Sum of Atlas::getFreeArea() of all pages
+		int getAtlasFreeArea() const;
+
+		// Switch all pages to another packer, resets the atlas when it changes
+		bool setAtlasPacker( int packer );
+
+		// Share of the used area of the atlas not covered by the live glyphs: holes of the evicted glyphs and space wasted by the packer. 0 when nothing is used.
+		float getAtlasFragmentation() const;
+
+		// Repack the live glyphs of all fonts tightly, sorted by height, moving their pixels inside the textures. Pages left empty are dropped.
+		// The texture coordinates of the glyphs change, every page is marked dirty. Returns false and keeps the atlas if out of memory or the glyphs don't fit.
+		bool compactAtlas();
+
+		// Called by fonsNextFrame, compacts the atlas if it's more fragmented than compactThreshold and some glyphs were evicted since the last compaction
+		void compactIfFragmented();
+
 		Context( FONSparams* params );
 		Context() = default;
 
@@ -76,14 +209,100 @@ namespace FontStash2
 
 		FONSstate* getState();
 
-		GlyphValue* getGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, int bitmapOption );
+		// Find the font and glyph index for the codepoint, using the charmap cache of the font
+		FONSfont* resolveGlyphIndex( FONSfont& font, unsigned int codepoint, uint32_t& glyphIndex );
+
+		// The phase is from getSubpixelPhase(), 0 for the glyphs at whole pixels
+		GlyphValue* getGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, int bitmapOption );
+
+		// Glyph with the signed distance field rendered at distanceFieldSize, used for the text of any size. Returns nullptr if the atlas is full.
+		GlyphValue* getDistanceFieldGlyph( FONSfont& font, unsigned int codepoint, int bitmapOption );
+
+		// Size to rasterize the glyphs of the state at, in 0.1 pixels, and the scale of their quads to the size of the text.
+		// The scale is 0 when the glyphs are drawn at the size they're rasterized at. For the distance field glyphs, the size is not used.
+		// Only drawing passes true for drawing, it extends the streak of the size; measuring reads the same decision without changing it.
+		float getGlyphScale( const FONSstate& state, short& glyphSize, bool drawing );
+
+		// True if the size was drawn in more than sizeSettleFrames consecutive frames, including this one.
+		// With drawing false, the streak is not started or extended.
+		bool isSizeSettled( short isize, bool drawing );
+
+		bool hasRasterBudget() const
+		{
+			return frameGlyphBudget > 0 || frameMicrosBudget > 0;
+		}
+
+		// False when this frame has rasterized all the glyphs it can
+		bool withinRasterBudget() const;
+
+		// getGlyph() for the text of the current frame, limited by the rasterization budget, or rasterizing on the background thread when it's enabled.
+		// Over the budget the glyph is deferred to the next frames, on the thread it's submitted there, and this returns the glyph at
+		// a recently drawn size, multiplying glyphScale to scale it, or the placeholder. Returns nullptr if the atlas is full.
+		// The glyphs without the bitmaps, for measuring, are always loaded at once and never substituted.
+		GlyphValue* getGlyphForFrame( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, int bitmapOption, float& glyphScale );
+
+		// Called by fonsNextFrame, rasterizes the deferred glyphs within the budget of the new frame
+		void finishDeferredGlyphs();
+
+		void rememberSize( short isize );
+
+		// Start or stop the background rasterization thread, returns false if failed to create it
+		bool setAsyncRasterization( bool enabled );
+
+		// Queue the glyph for the background thread unless it's already there, or the thread has the most glyphs in flight
+		void submitAsyncGlyph( FONSfont& font, const GlyphKey& key );
+
+		// Called by fonsNextFrame, packs the glyphs finished by the background thread into the atlas, in the order they were submitted
+		void collectAsyncGlyphs();
+
+		// Allocate atlas space for the glyph if the bitmap is required, and write the cached GlyphValue. Returns nullptr if the atlas is full.
+		GlyphValue* placeGlyph( FONSfont& font, const GlyphKey& key, float scale, uint32_t glyphIndex, const GlyphMetrics& metrics, int bitmapOption );
+
+		// Make the blurred glyph from the pixels of the sharp one, which is rasterized first when missing. Returns nullptr if the atlas is full.
+		GlyphValue* deriveBlurredGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase );
+
+		// Phase of the glyph which getQuad() will place at the pen position x, in GlyphKey units. 0 when the subpixel positioning is off.
+		short getSubpixelPhase( FONSfont& font, int prevGlyphIndex, unsigned int codepoint, float scale, float spacing, float x );
+
+		// Evict the least recently used glyphs until the free list of the atlas can fit the w*h rectangle. Returns false if it can't.
+		bool evictGlyphs( int w, int h );
+
+		// Blur the glyph after the pixels were copied to the texture, and add it to the dirty rectangle
+		void commitGlyph( const GlyphValue* glyph, short iblur );
+
+		// 0 or 1 disables the worker threads
+		bool setRasterThreads( int count );
+
+		// Queue the glyph for the workers unless it's already in the atlas or in the queue.
+		// When skipMissing is true, ignores codepoints which none of the fonts have.
+		void queueGlyph( FONSfont& font, unsigned int codepoint, short isize, short iblur, short phase, bool skipMissing );
+
+		// Rasterize the queued glyphs on the workers, then pack them into the atlas on this thread, in the order they were queued.
+		// Returns count of glyphs added, sets atlasFull when stopped because the atlas is full.
+		int flushRasterJobs( FONSfont& font, bool& atlasFull );
+
+		// When the worker threads are enabled and the text has enough missing glyphs, render them in parallel.
+		// Does nothing with the subpixel positioning, the phases are only known while laying out the text, with the rasterization budget, and with the background thread.
+		void prefetchGlyphs( FONSfont& font, const char* str, const char* end, short isize, short iblur );
 
 		float getVertAlign( FONSfont& font, int align, short isize ) const
 		{
 			return font.getVertAlign( params.flags & FONS_ZERO_TOPLEFT, align, isize );
 		}
 
-		void getQuad( FONSfont& font, int prevGlyphIndex, GlyphValue* glyph, float scale, float spacing, float* x, float* y, FONSquad* q );
+		// Rasterize all glyphs from the codepoint ranges at all the sizes, with the blur and the glyph mode of the state, stop when the atlas is full.
+		// The glyphs have the keys the text drawn with the state looks up: the distance field glyphs, or the bucket sizes from getGlyphScale(),
+		// at all subpixel phases when they're not scaled. Returns false if the atlas is full.
+		bool prewarmGlyphs( FONSfont& font, const FONSstate& state, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, FONSprewarmStats& stats );
+
+		// prewarmGlyphs() for the distance field glyphs, rendered once at distanceFieldSize for all sizes
+		bool prewarmDistanceField( FONSfont& font, const unsigned int* ranges, int nranges, FONSprewarmStats& stats );
+
+		// The glyphScale is from getGlyphScale(), the scaled glyphs are placed without snapping to pixels
+		void getQuad( FONSfont& font, int prevGlyphIndex, GlyphValue* glyph, float scale, float spacing, float glyphScale, float* x, float* y, FONSquad* q );
+
+		// Copy the dirty rectangles of the page for upload and clear them, counting the uploaded bytes. Returns count of the rectangles.
+		int takeDirtyRects( int page, int* rects, int maxRects );
 
 		void flush();
 		void vertex( float x, float y, float s, float t, unsigned int c );
@@ -92,7 +311,12 @@ namespace FontStash2
 		void popState();
 		void clearState();
 
-		int addFont( const char* name, std::vector<uint8_t>& data );
+		int addFont( const char* name, std::shared_ptr<const FontSource> data );
+
+		// Write the atlas texture, skyline and glyphs of all fonts to a file
+		bool saveCache( const char* path );
+		// Replace the atlas and glyphs with the file written by saveCache(). Returns false and keeps the state if the file doesn't match the fonts or the build.
+		bool loadCache( const char* path );
 
 		int debugDumpAtlas( const char* path ) const;
 	};
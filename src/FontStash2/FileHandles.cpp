@@ -1,4 +1,13 @@
 #include "FileHandles.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 bool ReadFileHandle::readAllBytes( std::vector<uint8_t> &data )
 {
@@ -29,4 +38,59 @@ bool WriteFileHandle::write( const void* pv, size_t cb )
 		return false;
 	const size_t written = fwrite( pv, 1, cb, m_handle );
 	return written == cb;
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile( const char* path )
+{
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( INVALID_HANDLE_VALUE == file )
+		return;
+	LARGE_INTEGER length;
+	if( GetFileSizeEx( file, &length ) && length.QuadPart > 0 && (uint64_t)length.QuadPart <= SIZE_MAX )
+	{
+		// The mapping keeps the file open, the handle is no longer needed after that
+		m_mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( nullptr != m_mapping )
+		{
+			m_data = (const uint8_t*)MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 );
+			if( nullptr != m_data )
+				m_size = (size_t)length.QuadPart;
+		}
+	}
+	CloseHandle( file );
+}
+
+MappedFile::~MappedFile()
+{
+	if( nullptr != m_data )
+		UnmapViewOfFile( m_data );
+	if( nullptr != m_mapping )
+		CloseHandle( m_mapping );
+}
+#else
+MappedFile::MappedFile( const char* path )
+{
+	const int fd = open( path, O_RDONLY );
+	if( fd < 0 )
+		return;
+	struct stat st;
+	if( 0 == fstat( fd, &st ) && st.st_size > 0 )
+	{
+		void* p = mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if( MAP_FAILED != p )
+		{
+			m_data = (const uint8_t*)p;
+			m_size = (size_t)st.st_size;
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	close( fd );
+}
+
+MappedFile::~MappedFile()
+{
+	if( nullptr != m_data )
+		munmap( (void*)m_data, m_size );
+}
+#endif
\ No newline at end of file
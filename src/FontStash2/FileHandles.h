@@ -63,4 +63,36 @@ public:
 	{
 		return write( &e, sizeof( E ) );
 	}
+};
+
+// Read-only memory mapped file
+class MappedFile
+{
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_mapping = nullptr;
+#endif
+
+public:
+	MappedFile( const char* path );
+	~MappedFile();
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile( MappedFile&& ) = delete;
+
+	operator bool() const
+	{
+		return nullptr != m_data;
+	}
+
+	const uint8_t* data() const
+	{
+		return m_data;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+namespace FontStash2
+{
+	// Open addressing hash map with linear probing, with 64-bit integer keys.
+	// Keys and values are stored in two parallel vectors, probing only touches the keys, 8 of them per cache line.
+	// Key with zero bits marks empty slots, users must make sure they never insert that key.
+	// Pointers returned by the methods are invalidated when the table grows. Growing happens on insert(), never on lookup.
+	template<class TValue>
+	class FlatMap
+	{
+		// Initial capacity of the hash map, must be a power of 2
+		static constexpr uint32_t initialCapacity = 64;
+
+		std::vector<uint64_t> keys;
+		std::vector<TValue> values;
+		// Count of used slots
+		uint32_t count = 0;
+		// keys.size() - 1, the capacity is always a power of 2
+		uint32_t mask = 0;
+		// 64 - log2( capacity )
+		uint32_t shift = 64;
+
+		// Fibonacci hashing: multiply by 2^64 / golden ratio, use the highest bits of the product.
+		uint32_t slot( uint64_t key ) const
+		{
+			return (uint32_t)( ( key * 0x9E3779B97F4A7C15ull ) >> shift );
+		}
+
+		void rehash( uint32_t capacity )
+		{
+			std::vector<uint64_t> oldKeys;
+			std::vector<TValue> oldValues;
+			oldKeys.swap( keys );
+			oldValues.swap( values );
+			keys.assign( capacity, 0 );
+			values.resize( capacity );
+
+			mask = capacity - 1;
+			shift = 64;
+			for( uint32_t c = capacity; c > 1; c >>= 1 )
+				shift--;
+
+			const uint32_t oldCapacity = (uint32_t)oldKeys.size();
+			for( uint32_t i = 0; i < oldCapacity; i++ )
+			{
+				const uint64_t key = oldKeys[ i ];
+				if( 0 == key )
+					continue;
+				uint32_t j = slot( key );
+				while( 0 != keys[ j ] )
+					j = ( j + 1 ) & mask;
+				keys[ j ] = key;
+				values[ j ] = oldValues[ i ];
+			}
+		}
+
+	public:
+
+		// Lookup a value, returns nullptr if not found
+		TValue* find( uint64_t k ) const
+		{
+			if( 0 == count )
+				return nullptr;
+			for( uint32_t i = slot( k ); ; i = ( i + 1 ) & mask )
+			{
+				const uint64_t key = keys[ i ];
+				if( key == k )
+					return const_cast<TValue*>( &values[ i ] );
+				if( 0 == key )
+					return nullptr;
+			}
+		}
+
+		// Find or insert a value. Newly inserted values are value-initialized.
+		TValue* insert( uint64_t k )
+		{
+			TValue* const existing = find( k );
+			if( nullptr != existing )
+				return existing;
+
+			// Keep the load factor at most 1/2, linear probing degrades quickly above that.
+			const uint32_t capacity = (uint32_t)keys.size();
+			if( ( count + 1 ) * 2 > capacity )
+				rehash( std::max( capacity * 2, initialCapacity ) );
+
+			uint32_t i = slot( k );
+			while( 0 != keys[ i ] )
+				i = ( i + 1 ) & mask;
+			keys[ i ] = k;
+			values[ i ] = TValue{};
+			count++;
+			return &values[ i ];
+		}
+
+		// Remove all values, but keep the memory
+		void clear()
+		{
+			if( 0 == count )
+				return;
+			std::fill( keys.begin(), keys.end(), 0 );
+			count = 0;
+		}
+
+		uint32_t size() const
+		{
+			return count;
+		}
+
+		// Count of slots. When this number changes, all previously returned pointers are invalidated.
+		uint32_t capacity() const
+		{
+			return (uint32_t)keys.size();
+		}
+
+		// Call the functor for every element in the map, the arguments are ( uint64_t key, TValue& value )
+		template<class Func>
+		void forEach( Func fn )
+		{
+			const uint32_t capacity = (uint32_t)keys.size();
+			for( uint32_t i = 0; i < capacity; i++ )
+				if( 0 != keys[ i ] )
+					fn( keys[ i ], values[ i ] );
+		}
+	};
+}
\ No newline at end of file
@@ -3,11 +3,13 @@
 #include "../fontstash.enums.h"
 #include "logger.h"
 #include "debugSaveGlyphs.h"
+#include "cleartype.h"
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_ADVANCES_H
 #include <math.h>
+#include <string.h>
 #include <algorithm>
 
 #ifdef NANOVG_CLEARTYPE
@@ -19,30 +21,21 @@
 
 namespace FontStash2
 {
-	static FT_Library ftLibrary = nullptr;
-
-	bool freetypeInit()
+	FT_Library freetypeNewLibrary()
 	{
-		if( nullptr != ftLibrary )
-			return true;
-		FT_Error ftError = FT_Init_FreeType( &ftLibrary );
+		FT_Library library;
+		FT_Error ftError = FT_Init_FreeType( &library );
 		if( ftError != 0 )
-			return false;
+			return nullptr;
 #ifdef NANOVG_CLEARTYPE
-		ftError = FT_Library_SetLcdFilter( ftLibrary, FT_LCD_FILTER_DEFAULT );
+		ftError = FT_Library_SetLcdFilter( library, FT_LCD_FILTER_DEFAULT );
 		if( ftError != 0 )
-			return false;
+		{
+			FT_Done_FreeType( library );
+			return nullptr;
+		}
 #endif
-		return true;
-	}
-
-	bool freetypeDone()
-	{
-		if( nullptr == ftLibrary )
-			return true;
-		const FT_Error ftError = FT_Done_FreeType( ftLibrary );
-		ftLibrary = nullptr;
-		return ftError == 0;
+		return library;
 	}
 
 	constexpr FT_Int32 loadFlagsNormal = FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT;
@@ -52,11 +45,17 @@ namespace FontStash2
 #else
 	constexpr FT_Int32 loadFlags = loadFlagsNormal;
 #endif
+
+	uint32_t freetypeLoadFlags()
+	{
+		return (uint32_t)loadFlags;
+	}
 }
 
 using namespace FontStash2;
 
-Font::Font( int maxFallbacks ) :
+Font::Font( int index, int maxFallbacks ) :
+	index( index ),
 	maxFallbackFonts( maxFallbacks )
 { }
 
@@ -65,21 +64,21 @@ bool Font::tryAddFallback( int i )
 	if( (int)fallbacks.size() < maxFallbackFonts )
 	{
 		fallbacks.push_back( i );
+		// The new fallback may have glyphs for codepoints which were cached as missing
+		charmap.clear();
 		return true;
 	}
 	return false;
 }
 
-bool Font::initialize( const char* name, std::vector<uint8_t>& buffer )
+bool Font::initialize( const char* name, std::shared_ptr<const FontSource> data )
 {
 	clear();
 
-	const FT_Error ftError = FT_New_Memory_Face( ftLibrary, buffer.data(), (FT_Long)buffer.size(), 0, &font );
-	if( ftError != 0 )
-	{
-		// logError( "FT_New_Memory_Face failed" );
+	face = FontFace::open( std::move( data ) );
+	if( nullptr == face )
 		return false;
-	}
+	font = face->get();
 
 	const int ascent = font->ascender;
 	const int descent = font->descender;
@@ -92,25 +91,25 @@ bool Font::initialize( const char* name, std::vector<uint8_t>& buffer )
 
 	strncpy( this->name, name, sizeof( this->name ) );
 	this->name[ sizeof( this->name ) - 1 ] = '\0';
-	data.swap( buffer );
 
 	return true;
 }
 
 void Font::clear()
 {
-	if( nullptr != font )
-	{
-		FT_Done_Face( font );
-		font = nullptr;
-	}
+	face.reset();
+	font = nullptr;
 	glyphs.clear();
+	latin1.clear();
+	charmap.clear();
 	fallbacks.clear();
+	contentHash = 0;
 }
 
 void Font::reset()
 {
 	glyphs.clear();
+	latin1.clear();
 }
 
 bool Font::hasName( const char* str ) const
@@ -118,19 +117,29 @@ bool Font::hasName( const char* str ) const
 	return 0 == strcmp( str, name );
 }
 
-GlyphValue* Font::lookupGlyph( const GlyphKey & k ) const
-{
-	auto it = glyphs.find( k );
-	if( it == glyphs.end() )
-		return nullptr;
-	return const_cast<GlyphValue*>( &it->second );
-}
-
-int Font::getGlyphKernAdvance( int glyph1, int glyph2 ) const
+uint64_t Font::getContentHash()
 {
-	FT_Vector ftKerning;
-	FT_Get_Kerning( font, glyph1, glyph2, FT_KERNING_DEFAULT, &ftKerning );
-	return (int)( ( ftKerning.x + 32 ) >> 6 );  // Round up and convert to integer
+	if( 0 != contentHash )
+		return contentHash;
+
+	// FNV-1a over 8-byte words, seeded with the length. This identifies cache files, it doesn't need to resist attacks.
+	constexpr uint64_t prime = 0x100000001B3ull;
+	const size_t length = face ? face->getSource().size() : 0;
+	const uint8_t* const bytes = face ? face->getSource().data() : nullptr;
+	const uint8_t* p = bytes;
+	uint64_t h = 0xCBF29CE484222325ull ^ (uint64_t)length;
+	const size_t words = length / 8;
+	for( size_t i = 0; i < words; i++, p += 8 )
+	{
+		uint64_t w;
+		memcpy( &w, p, 8 );
+		h = ( h ^ w ) * prime;
+		h ^= h >> 29;
+	}
+	for( size_t i = words * 8; i < length; i++ )
+		h = ( h ^ bytes[ i ] ) * prime;
+	contentHash = ( 0 != h ) ? h : 1;
+	return contentHash;
 }
 
 float Font::getPixelHeightScale( float size ) const
@@ -143,96 +152,208 @@ uint32_t Font::getGlyphIndex( unsigned int codepoint ) const
 	return FT_Get_Char_Index( font, codepoint );
 }
 
-bool Font::buildGlyphBitmap( int glyph, float size, int *advance, int *lsb, int *x0, int *y0, int *x1, int *y1 ) const
+int Font::getGlyphAdvance( uint32_t glyph ) const
 {
-	FT_Error ftError = FT_Set_Pixel_Sizes( font, 0, (FT_UInt)( size * (float)font->units_per_EM / (float)( font->ascender - font->descender ) ) );
-	if( ftError ) return false;
-	ftError = FT_Load_Glyph( font, glyph, loadFlags );
+	FT_Fixed advFixed;
+	if( 0 != FT_Get_Advance( font, glyph, FT_LOAD_NO_SCALE, &advFixed ) )
+		return 0;
+	return (int)advFixed;
+}
+
+uint32_t Font::getPixelSize( float size ) const
+{
+	return (uint32_t)( size * (float)font->units_per_EM / (float)( font->ascender - font->descender ) );
+}
+
+uint32_t Font::getFractionalPixelSize( float size ) const
+{
+	return (uint32_t)( size * 64.0f * (float)font->units_per_EM / (float)( font->ascender - font->descender ) + 0.5f );
+}
+
+// Load and render the glyph into the glyph slot of the face, and measure it. The face must have the correct size already.
+static bool loadGlyph( FT_Face face, int glyph, short phase, GlyphMetrics& metrics )
+{
+	FT_Error ftError;
+	if( 0 == phase )
+		ftError = FT_Load_Glyph( face, glyph, loadFlags );
+	else
+	{
+		// The translation applies to the hinted outline, the bitmap and bitmap_left include it. The value is in 1/64 of a pixel.
+		FT_Vector delta{ phase * 64 / GlyphKey::phaseSteps, 0 };
+		FT_Set_Transform( face, nullptr, &delta );
+		ftError = FT_Load_Glyph( face, glyph, loadFlags );
+		FT_Set_Transform( face, nullptr, nullptr );
+	}
 	if( ftError ) return false;
 
 	FT_Fixed advFixed;
-	ftError = FT_Get_Advance( font, glyph, FT_LOAD_NO_SCALE, &advFixed );
+	ftError = FT_Get_Advance( face, glyph, FT_LOAD_NO_SCALE, &advFixed );
 	if( ftError ) return false;
-	FT_GlyphSlot ftGlyph = font->glyph;
-	*advance = (int)advFixed;
-	*lsb = (int)ftGlyph->metrics.horiBearingX;
-	*x0 = ftGlyph->bitmap_left;
+	FT_GlyphSlot ftGlyph = face->glyph;
+	metrics.advance = (int)advFixed;
+	metrics.lsb = (int)ftGlyph->metrics.horiBearingX;
+	metrics.x0 = ftGlyph->bitmap_left;
 #ifdef NANOVG_CLEARTYPE
 	assert( 0 == ( ftGlyph->bitmap.width % 3 ) );
-	*x1 = *x0 + ftGlyph->bitmap.width / 3;
+	metrics.x1 = metrics.x0 + ftGlyph->bitmap.width / 3;
 #else
-	*x1 = *x0 + ftGlyph->bitmap.width;
+	metrics.x1 = metrics.x0 + ftGlyph->bitmap.width;
 #endif
-	*y0 = -ftGlyph->bitmap_top;
-	*y1 = *y0 + ftGlyph->bitmap.rows;
+	metrics.y0 = -ftGlyph->bitmap_top;
+	metrics.y1 = metrics.y0 + ftGlyph->bitmap.rows;
+	return true;
+}
+
+bool Font::buildGlyphBitmap( int glyph, float size, short phase, GlyphMetrics& metrics )
+{
+	if( !face->activatePixelSize( getPixelSize( size ) ) )
+		return false;
+	if( !loadGlyph( font, glyph, phase, metrics ) )
+		return false;
+	FT_GlyphSlot ftGlyph = font->glyph;
 	logDebug( "Font::buildGlyphBitmap: glyph %i, size %f, outHeight %i", glyph, size, ftGlyph->bitmap.rows );
 
 	debugSaveGlyph( ftGlyph, glyph, size, "gray" );
 	return true;
 }
 
-GlyphValue* Font::allocGlyph( unsigned int codepoint, short isize, short blur )
+FT_Face Font::createFace( FT_Library library ) const
 {
-	const GlyphKey key{ codepoint, isize, blur };
-	return &glyphs[ key ];
+	const FontSource& source = face->getSource();
+	FT_Face res;
+	if( 0 != FT_New_Memory_Face( library, source.data(), (FT_Long)source.size(), 0, &res ) )
+		return nullptr;
+	return res;
 }
 
-#ifdef NANOVG_CLEARTYPE
+bool Font::rasterizeGlyph( FT_Face face, int glyph, float size, short phase, GlyphBitmap& result ) const
+{
+	// The size is computed from this->font, the other face has the same metrics because it was created from the same data.
+	if( 0 != FT_Set_Pixel_Sizes( face, 0, getPixelSize( size ) ) )
+		return false;
+	if( !loadGlyph( face, glyph, phase, result.metrics ) )
+		return false;
+
+	const FT_Bitmap& bitmap = face->glyph->bitmap;
+	result.pitch = (int)bitmap.width;
+	result.rows = (int)bitmap.rows;
+	result.pixels.resize( (size_t)result.pitch * result.rows );
+	const uint8_t* sourceLine = bitmap.buffer;
+	uint8_t* dest = result.pixels.data();
+	for( int y = 0; y < result.rows; y++ )
+	{
+		std::copy_n( sourceLine, result.pitch, dest );
+		sourceLine += bitmap.pitch;
+		dest += result.pitch;
+	}
+	return true;
+}
 
-// Pack 3 grayscale sub-pixel bytes into a single RGBA pixel.
-inline uint32_t packCleartypeSubpixels( const uint8_t* triple )
+bool Font::buildCoverage( int glyph, float size, GlyphBitmap& result )
 {
-	uint32_t res = triple[ 0 ];
-	res |= ( ( (uint32_t)triple[ 1 ] ) << 8 );
-	res |= ( ( (uint32_t)triple[ 2 ] ) << 16 );
-	// On PC GPUs, it's much faster to do in pixel shader. On slow embedded ARM this is probably not the case.
-	// Ideally we might want max, not bitwise OR, but OR is much faster to compute in scalar code, too bad scalar parts of CPUs don't have instructions like pmaxub (PC) / umax (ARM).
-	// This code only runs while building textures, i.e. much less frequent than each frame.
-	const uint32_t all = triple[ 0 ] | triple[ 1 ] | triple[ 2 ];
-	res |= ( all << 24 );
-	return res;
+	result.metrics = GlyphMetrics{};
+	result.pitch = 0;
+	result.rows = 0;
+	// The field is scaled to other sizes, the outline is not hinted and the size is not rounded to whole pixels
+	if( !face->activateFractionalSize( getFractionalPixelSize( size ) ) )
+		return false;
+	if( 0 != FT_Load_Glyph( font, glyph, FT_LOAD_RENDER | FT_LOAD_NO_HINTING ) )
+		return false;
+	FT_Fixed advFixed;
+	if( 0 != FT_Get_Advance( font, glyph, FT_LOAD_NO_SCALE, &advFixed ) )
+		return false;
+
+	const FT_GlyphSlot ftGlyph = font->glyph;
+	const FT_Bitmap& bitmap = ftGlyph->bitmap;
+	GlyphMetrics& metrics = result.metrics;
+	metrics.advance = (int)advFixed;
+	metrics.lsb = (int)ftGlyph->metrics.horiBearingX;
+	metrics.x0 = ftGlyph->bitmap_left;
+	metrics.y0 = -ftGlyph->bitmap_top;
+	// Bitmap fonts may render 1-bit pixels, these glyphs keep the metrics without the pixels
+	if( bitmap.pixel_mode != FT_PIXEL_MODE_GRAY )
+	{
+		metrics.x1 = metrics.x0;
+		metrics.y1 = metrics.y0;
+		return true;
+	}
+	metrics.x1 = metrics.x0 + (int)bitmap.width;
+	metrics.y1 = metrics.y0 + (int)bitmap.rows;
+
+	result.pitch = (int)bitmap.width;
+	result.rows = (int)bitmap.rows;
+	result.pixels.resize( (size_t)result.pitch * result.rows );
+	const uint8_t* sourceLine = bitmap.buffer;
+	uint8_t* dest = result.pixels.data();
+	for( int y = 0; y < result.rows; y++ )
+	{
+		std::copy_n( sourceLine, result.pitch, dest );
+		sourceLine += bitmap.pitch;
+		dest += result.pitch;
+	}
+	return true;
 }
 
-void Font::renderGlyphBitmap( uint32_t *output, int outWidth, int outHeight, int outStride ) const
+GlyphValue* Font::allocGlyph( const GlyphKey& key )
 {
-	FT_GlyphSlot ftGlyph = font->glyph;
-	const int rgbWidth = ftGlyph->bitmap.width / 3;
-	const uint8_t* sourceLine = ftGlyph->bitmap.buffer;
-	const size_t sourceStride = ftGlyph->bitmap.pitch;
+	const uint32_t oldCapacity = glyphs.capacity();
+	GlyphValue* const res = glyphs.insert( key );
+	// When the hash map grows, the values move to another place in memory
+	if( glyphs.capacity() != oldCapacity )
+		latin1.clear();
+	if( Latin1Cache::covers( key.codepoint() ) )
+		latin1.store( key, res );
+	return res;
+}
+
+#ifdef NANOVG_CLEARTYPE
 
-	for( uint32_t y = 0; y < ftGlyph->bitmap.rows; y++ )
+// Convert FreeType LCD output, 3 bytes per pixel, into RGBA pixels
+static void copyGlyphPixels( const uint8_t* sourceLine, size_t sourceStride, uint32_t sourceWidth, uint32_t rows, uint32_t *output, int outStride )
+{
+	// On PC GPUs, it's much faster to do in pixel shader. On slow embedded ARM this is probably not the case.
+	const uint32_t rgbWidth = sourceWidth / 3;
+	for( uint32_t y = 0; y < rows; y++ )
 	{
-		const uint8_t* src = sourceLine;
-		uint32_t *dest = output;
-		for( int x = 0; x < rgbWidth; x++ )
-		{
-			*dest = packCleartypeSubpixels( src );
-			src += 3;
-			dest++;
-		}
+		packClearTypeRow( output, sourceLine, rgbWidth );
 		sourceLine += sourceStride;
 		output += outStride;
 	}
 }
 
-#else
+void Font::renderGlyphBitmap( uint32_t *output, int outWidth, int outHeight, int outStride ) const
+{
+	const FT_Bitmap& bitmap = font->glyph->bitmap;
+	copyGlyphPixels( bitmap.buffer, bitmap.pitch, bitmap.width, bitmap.rows, output, outStride );
+}
 
-void Font::renderGlyphBitmap( unsigned char *output, int outWidth, int outHeight, int outStride ) const
+void Font::renderGlyphBitmap( const GlyphBitmap& bitmap, uint32_t *output, int outStride )
 {
-	FT_GlyphSlot ftGlyph = font->glyph;
-	const uint8_t* sourceLine = ftGlyph->bitmap.buffer;	// Read pointer
-	const size_t sourceStride = ftGlyph->bitmap.pitch;	// Bytes to skip between source lines
-	const uint32_t height = ftGlyph->bitmap.rows;	// Rows to copy
+	copyGlyphPixels( bitmap.pixels.data(), bitmap.pitch, bitmap.pitch, bitmap.rows, output, outStride );
+}
 
-	const size_t lineWidth = ftGlyph->bitmap.width;	// Bytes to copy per each line
+#else
 
-	for( uint32_t y = 0; y < height; y++ )
+static void copyGlyphPixels( const uint8_t* sourceLine, size_t sourceStride, uint32_t sourceWidth, uint32_t rows, unsigned char *output, int outStride )
+{
+	for( uint32_t y = 0; y < rows; y++ )
 	{
-		std::copy_n( sourceLine, lineWidth, output );
+		std::copy_n( sourceLine, sourceWidth, output );
 		sourceLine += sourceStride;
 		output += outStride;
 	}
 }
+
+void Font::renderGlyphBitmap( unsigned char *output, int outWidth, int outHeight, int outStride ) const
+{
+	const FT_Bitmap& bitmap = font->glyph->bitmap;
+	copyGlyphPixels( bitmap.buffer, bitmap.pitch, bitmap.width, bitmap.rows, output, outStride );
+}
+
+void Font::renderGlyphBitmap( const GlyphBitmap& bitmap, unsigned char *output, int outStride )
+{
+	copyGlyphPixels( bitmap.pixels.data(), bitmap.pitch, bitmap.pitch, bitmap.rows, output, outStride );
+}
 #endif
 
 float Font::getVertAlign( bool zeroTopLeft, int align, short isize ) const
@@ -1,87 +1,75 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
-#include "PlexAlloc/Allocator.hpp"
-#include <unordered_map>
+#include <memory>
+#include "GlyphMap.h"
+#include "Latin1Cache.h"
+#include "FontFace.h"
 
 // We don't need to include FreeType here. Forward declaration is enough, reduce compilation time.
 typedef struct FT_FaceRec_* FT_Face;
+typedef struct FT_SizeRec_* FT_Size;
+typedef struct FT_LibraryRec_* FT_Library;
 
 namespace FontStash2
 {
-	struct GlyphValue
+	// Result of the codepoint -> glyph index resolution, including the fallback fonts
+	struct CharmapEntry
 	{
-		uint32_t index;
-		short x0, y0, x1, y1;
-		short xadv, xoff, yoff;
+		// Index of the font which has the glyph, or -1 for the font which owns the cache. Also -1 when none of the fonts have the glyph.
+		int font;
+		// Glyph index in that font, 0 when not found
+		uint32_t glyph;
+	};
 
-		bool hasBitmap() const
-		{
-			return x0 >= 0 && y0 >= 0;
-		}
+	// Glyph metrics from FreeType. The advance is in font units, the rest is in pixels.
+	struct GlyphMetrics
+	{
+		int advance, lsb, x0, y0, x1, y1;
+	};
+
+	// Glyph image copied out of FreeType glyph slot, so it can be rendered on another thread and packed into the atlas later.
+	struct GlyphBitmap
+	{
+		GlyphMetrics metrics;
+		// Bytes per row, rows are tightly packed. In ClearType builds there're 3 bytes per pixel.
+		int pitch;
+		int rows;
+		std::vector<uint8_t> pixels;
 	};
 
 	class Font
 	{
+		// Position in Context::fonts, the fonts are never removed
+		const int index;
+		// The parsed font, shared with other fonts on this thread which loaded the same file
+		std::shared_ptr<FontFace> face;
+		// Same as face->get()
 		FT_Face font = nullptr;
 		char name[ 64 ];
-		// Source data, i.e. .TTF file in RAM. Apparently, FreeType2 library doesn't copy it to internal structures.
-		std::vector<uint8_t> data;
+		// Hash of the above data, computed on demand, 0 when not computed yet
+		uint64_t contentHash = 0;
+
+		// The value to pass to FT_Set_Pixel_Sizes for the font size
+		uint32_t getPixelSize( float size ) const;
+		// Same in 1/64 of a pixel, not rounded to whole pixels
+		uint32_t getFractionalPixelSize( float size ) const;
 
 		// Values from font->ascender/descender, scaled relatively to line height 
 		float ascender, descender;
 		float lineh;
 
-		// Key for the hash map
-		struct GlyphKey
-		{
-			unsigned int codepoint;
-			short size;
-#ifndef NANOVG_CLEARTYPE
-			short blur;
-#endif
-			bool operator == ( const GlyphKey &k ) const
-			{
-				return codepoint == k.codepoint && size == k.size 
-#ifndef NANOVG_CLEARTYPE
-					&& blur == k.blur
-#endif
-				;
-			}
-
-			GlyphKey() = default;
-
-#ifdef NANOVG_CLEARTYPE
-			GlyphKey( unsigned int cp, short s, short b ) :
-				codepoint( cp ), size( s ) { }
-#else
-			GlyphKey( unsigned int cp, short s, short b ) :
-				codepoint( cp ), size( s ), blur( b ) { }
-#endif
-		};
-
-		// Hasher for the above structure, for std::unordered_map
-		struct GlyphKeyHash
-		{
-			std::size_t operator()( const GlyphKey& k ) const
-			{
-				std::size_t hash = 17;
-				hash = hash * 31 + k.codepoint;
-				hash = hash * 31 + (uint16_t)k.size;
-#ifndef NANOVG_CLEARTYPE
-				hash = hash * 31 + (uint16_t)k.blur;
-#endif
-				return hash;
-			}
-		};
-
 		// The main hash map which maps (codepoint, size, blur) tuples into GlyphValue structures.
-		// Using PlexAlloc from https://github.com/Const-me/CollectionMicrobench to reduce RAM allocations and make it more cache friendly.
 		// Original C code used a fixed size hash map with 256 buckets, with linked list for every bucket, and elements stored in a single vector.
-		// Original is probably slightly faster for small atlases with ~64 glyphs, but this one scales much better.
-		using TAlloc = PlexAlloc::Allocator<std::pair<const GlyphKey, GlyphValue>, 128>;
-		using TGlyphsMap = std::unordered_map<GlyphKey, GlyphValue, GlyphKeyHash, std::equal_to<GlyphKey>, TAlloc>;
-		TGlyphsMap glyphs;
+		// Before that, this fork used std::unordered_map with PlexAlloc, which scales better but still chases 2 pointers per lookup.
+		// The open addressing table only does a single cache miss in the common case, this matters because there's a lookup per glyph per frame.
+		GlyphMap glyphs;
+		// Direct-indexed fast path in front of the above map, for the first 256 codepoints
+		Latin1Cache latin1;
+
+		// Caches codepoint -> glyph index resolution, including fallback fonts and negative results.
+		// Unlike the glyphs, it's not cleared by reset(), it doesn't depend on the atlas.
+		FlatMap<CharmapEntry> charmap;
 
 		// Indices of fall back fonts
 		const int maxFallbackFonts;
@@ -89,15 +77,13 @@ namespace FontStash2
 
 		void clear();
 
-		GlyphValue* lookupGlyph( const GlyphKey & k ) const;
-
 	public:
 
-		Font( int maxFallbacks );
+		Font( int index, int maxFallbacks );
 		~Font() { clear(); }
 
-		// Load FreeType font
-		bool initialize( const char* name, std::vector<uint8_t>& buffer );
+		// Load FreeType font, or reuse the face when the data is already loaded on this thread
+		bool initialize( const char* name, std::shared_ptr<const FontSource> data );
 
 		// Add index of a fall back font
 		bool tryAddFallback( int i );
@@ -106,16 +92,35 @@ namespace FontStash2
 		bool hasName( const char* str ) const;
 
 		// Lookup a glyph, returns nullptr if not found
-		GlyphValue* lookupGlyph( unsigned int codepoint, short isize, short blur ) const
+		GlyphValue* lookupGlyph( const GlyphKey& key )
 		{
-			return lookupGlyph( GlyphKey{ codepoint, isize, blur } );
+			if( !Latin1Cache::covers( key.codepoint() ) )
+				return glyphs.find( key );
+
+			GlyphValue* res = latin1.lookup( key );
+			if( nullptr != res )
+				return res;
+			res = glyphs.find( key );
+			if( nullptr != res )
+				latin1.store( key, res );
+			return res;
 		}
 
-		int getGlyphKernAdvance( int glyph1, int glyph2 ) const;
+		// Kerning of the glyph pair in font units, multiply by getPixelHeightScale() to get pixels.
+		// The text is kerned by the design value scaled linearly to the size, like the advances, not by the hinted value rounded to pixels.
+		int getGlyphKernAdvance( int glyph1, int glyph2 )
+		{
+			return face->getKernAdvance( glyph1, glyph2 );
+		}
 
 		bool empty() const
 		{
-			return data.empty();
+			return nullptr == face;
+		}
+
+		int getIndex() const
+		{
+			return index;
 		}
 
 		float getPixelHeightScale( float size ) const;
@@ -124,19 +129,58 @@ namespace FontStash2
 
 		uint32_t getGlyphIndex( unsigned int codepoint ) const;
 
+		// Advance of the glyph in font units without loading the outline, 0 if failed
+		int getGlyphAdvance( uint32_t glyph ) const;
+
+		// Lookup cached result of the glyph index resolution, returns nullptr if not cached
+		const CharmapEntry* lookupCharmap( unsigned int codepoint ) const
+		{
+			return charmap.find( (uint64_t)codepoint + 1 );
+		}
+
+		void cacheCharmap( unsigned int codepoint, int font, uint32_t glyph )
+		{
+			*charmap.insert( (uint64_t)codepoint + 1 ) = CharmapEntry{ font, glyph };
+		}
+
 		const std::vector<int> &getFallbackFonts() const
 		{
 			return fallbacks;
 		}
 
-		bool buildGlyphBitmap( int glyph, float size, int *advance, int *lsb, int *x0, int *y0, int *x1, int *y1 ) const;
+		// 64-bit hash of the font file, identifies the font in the cache files
+		uint64_t getContentHash();
+
+		// Call the functor for every cached glyph, the arguments are ( GlyphKey key, GlyphValue& value )
+		template<class Func>
+		void forEachGlyph( Func fn )
+		{
+			glyphs.forEach( fn );
+		}
+
+		// Render the glyph into the glyph slot of the face, for renderGlyphBitmap() to copy.
+		// The phase shifts the outline to the right, in 1/8 of a pixel, see GlyphKey.
+		bool buildGlyphBitmap( int glyph, float size, short phase, GlyphMetrics& metrics );
+
+		// Create another face from the same source data, on another FreeType library. Returns nullptr if failed.
+		// FreeType objects are not thread safe, worker threads use their own library and faces.
+		FT_Face createFace( FT_Library library ) const;
+
+		// Render the glyph on a face created by createFace(), and copy the bitmap out of the glyph slot.
+		bool rasterizeGlyph( FT_Face face, int glyph, float size, short phase, GlyphBitmap& result ) const;
+
+		// Render the glyph without hinting into 8-bit coverage, also in ClearType builds, the source of the distance field glyphs.
+		// Returns false and leaves an empty bitmap if FreeType fails.
+		bool buildCoverage( int glyph, float size, GlyphBitmap& result );
 
-		GlyphValue* allocGlyph( unsigned int codepoint, short isize, short blur );
+		GlyphValue* allocGlyph( const GlyphKey& key );
 
 #ifdef NANOVG_CLEARTYPE
 		void renderGlyphBitmap( uint32_t *output, int outWidth, int outHeight, int outStride ) const;
+		static void renderGlyphBitmap( const GlyphBitmap& bitmap, uint32_t *output, int outStride );
 #else
 		void renderGlyphBitmap( unsigned char *output, int outWidth, int outHeight, int outStride ) const;
+		static void renderGlyphBitmap( const GlyphBitmap& bitmap, unsigned char *output, int outStride );
 #endif
 
 		float getVertAlign( bool zeroTopLeft, int align, short isize ) const;
@@ -146,7 +190,9 @@ namespace FontStash2
 		void fonsLineBounds( bool zeroTopLeft, short isize, float y, float* miny, float* maxy ) const;
 	};
 
-	bool freetypeInit();
+	// Create another FreeType library instance, configured the same way as the main one. Returns nullptr if failed.
+	FT_Library freetypeNewLibrary();
 
-	bool freetypeDone();
+	// Flags passed to FT_Load_Glyph
+	uint32_t freetypeLoadFlags();
 }
\ No newline at end of file
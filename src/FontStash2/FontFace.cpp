@@ -0,0 +1,154 @@
+#include "FontFace.h"
+#include "Font.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SIZES_H
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+namespace FontStash2
+{
+	namespace
+	{
+		// Creating and destroying faces modifies the library, the lock serializes that across the threads
+		std::mutex ftLock;
+		FT_Library ftLibrary = nullptr;
+		int ftLibraryRefs = 0;
+
+		// Faces opened on the current thread. Weak references don't keep the faces alive, the entries expire with the last font.
+		thread_local std::map<const FontSource*, std::weak_ptr<FontFace>> openFaces;
+	}
+
+	bool freetypeInit()
+	{
+		std::lock_guard<std::mutex> lock( ftLock );
+		if( 0 == ftLibraryRefs )
+		{
+			ftLibrary = freetypeNewLibrary();
+			if( nullptr == ftLibrary )
+				return false;
+		}
+		ftLibraryRefs++;
+		return true;
+	}
+
+	bool freetypeDone()
+	{
+		std::lock_guard<std::mutex> lock( ftLock );
+		if( 0 == ftLibraryRefs )
+			return true;
+		if( 0 != --ftLibraryRefs )
+			return true;
+		const FT_Error ftError = FT_Done_FreeType( ftLibrary );
+		ftLibrary = nullptr;
+		return ftError == 0;
+	}
+
+	uint32_t freetypeVersion()
+	{
+		FT_Int major, minor, patch;
+		// Another context may be destroying the library on another thread
+		std::lock_guard<std::mutex> lock( ftLock );
+		if( nullptr == ftLibrary )
+			return 0;
+		FT_Library_Version( ftLibrary, &major, &minor, &patch );
+		return ( (uint32_t)major << 16 ) | ( (uint32_t)minor << 8 ) | (uint32_t)patch;
+	}
+
+	std::shared_ptr<FontFace> FontFace::open( std::shared_ptr<const FontSource> data )
+	{
+		std::weak_ptr<FontFace>& entry = openFaces[ data.get() ];
+		std::shared_ptr<FontFace> res = entry.lock();
+		if( res )
+			return res;
+
+		for( auto it = openFaces.begin(); it != openFaces.end(); )
+		{
+			if( it->second.expired() && &it->second != &entry )
+				it = openFaces.erase( it );
+			else
+				++it;
+		}
+
+		res = std::make_shared<FontFace>();
+		FT_Error ftError;
+		{
+			std::lock_guard<std::mutex> lock( ftLock );
+			ftError = FT_New_Memory_Face( ftLibrary, data->data(), (FT_Long)data->size(), 0, &res->face );
+		}
+		if( ftError != 0 )
+		{
+			// logError( "FT_New_Memory_Face failed" );
+			res->face = nullptr;
+			openFaces.erase( data.get() );
+			return nullptr;
+		}
+		res->hasKerning = FT_HAS_KERNING( res->face );
+		res->source = std::move( data );
+		entry = res;
+		return res;
+	}
+
+	FontFace::~FontFace()
+	{
+		if( nullptr == face )
+			return;
+		// This also destroys all size objects of the face
+		std::lock_guard<std::mutex> lock( ftLock );
+		FT_Done_Face( face );
+	}
+
+	bool FontFace::activateSize( uint32_t pixels )
+	{
+		if( !sizes.empty() && sizes.front().pixels == pixels )
+			return true;
+
+		auto it = std::find_if( sizes.begin(), sizes.end(), [ pixels ]( const SizeEntry& e ) { return e.pixels == pixels; } );
+		if( it != sizes.end() )
+		{
+			if( 0 != FT_Activate_Size( it->size ) )
+				return false;
+			// Move to the front of the LRU list
+			std::rotate( sizes.begin(), it, it + 1 );
+			return true;
+		}
+
+		SizeEntry e;
+		if( sizes.size() < maxSizes )
+		{
+			if( 0 != FT_New_Size( face, &e.size ) )
+				return false;
+			sizes.push_back( e );
+		}
+		else
+			e = sizes.back();	// Recycle the least recently used one
+
+		// Make sure failures below don't leave stale entry with that size object
+		sizes.back().pixels = 0;
+		std::rotate( sizes.begin(), sizes.end() - 1, sizes.end() );
+
+		if( 0 != FT_Activate_Size( e.size ) )
+			return false;
+		if( 0 != ( pixels & fractionalSize ) )
+		{
+			// At 72 DPI the points are pixels
+			if( 0 != FT_Set_Char_Size( face, 0, (FT_F26Dot6)( pixels & ~fractionalSize ), 72, 72 ) )
+				return false;
+		}
+		else if( 0 != FT_Set_Pixel_Sizes( face, 0, pixels ) )
+			return false;
+		sizes.front().pixels = pixels;
+		return true;
+	}
+
+	int FontFace::loadKernAdvance( int glyph1, int glyph2 ) const
+	{
+		// FT_KERNING_DEFAULT would return the value scaled to whatever size was last set on the face by buildGlyphBitmap.
+		// Unscaled font units are independent of that, and Context::getQuad scales them the same way as the advances.
+		FT_Vector ftKerning;
+		if( 0 != FT_Get_Kerning( face, glyph1, glyph2, FT_KERNING_UNSCALED, &ftKerning ) )
+			return 0;
+		return (int)ftKerning.x;
+	}
+}
\ No newline at end of file
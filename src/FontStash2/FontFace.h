@@ -0,0 +1,124 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include "FlatMap.hpp"
+#include "FontSource.h"
+
+typedef struct FT_FaceRec_* FT_Face;
+typedef struct FT_SizeRec_* FT_Size;
+
+namespace FontStash2
+{
+	// FreeType face parsed from the font data, shared by all fonts which load the same FontSource on the same thread.
+	// FreeType faces are not thread safe, contexts on different threads get different faces, over the same data.
+	// Together with the face, the fonts share the size objects and the kerning cache.
+	class FontFace
+	{
+		FT_Face face = nullptr;
+		// FreeType reads the data while the face is alive
+		std::shared_ptr<const FontSource> source;
+
+		// FreeType size objects for the recently used pixel sizes, most recently used first. The first one is active on the face.
+		// Switching between them with FT_Activate_Size is much cheaper than FT_Set_Pixel_Sizes, which recomputes scaling and hinting state.
+		static constexpr size_t maxSizes = 8;
+		struct SizeEntry
+		{
+			// Whole pixels, or 1/64 of a pixel with fractionalSize bit set
+			uint32_t pixels;
+			FT_Size size;
+		};
+		static constexpr uint32_t fractionalSize = 0x80000000u;
+		std::vector<SizeEntry> sizes;
+
+		// False when the font has no kerning table, getKernAdvance() then returns 0 without any lookups
+		bool hasKerning = false;
+		// Caches kerning of glyph pairs in font units. The values are unscaled, the cache is shared by all sizes.
+		FlatMap<int> kerning;
+
+		int loadKernAdvance( int glyph1, int glyph2 ) const;
+
+		bool activateSize( uint32_t pixels );
+
+	public:
+		FontFace() = default;
+		~FontFace();
+		FontFace( const FontFace& ) = delete;
+		void operator=( const FontFace& ) = delete;
+
+		// Returns the face already opened on the calling thread for the source, or parses a new one. Returns nullptr if failed.
+		static std::shared_ptr<FontFace> open( std::shared_ptr<const FontSource> data );
+
+		FT_Face get() const
+		{
+			return face;
+		}
+
+		const FontSource& getSource() const
+		{
+			return *source;
+		}
+
+		bool activatePixelSize( uint32_t pixels )
+		{
+			return activateSize( pixels );
+		}
+
+		// Same as above with the size in 1/64 of a pixel, for the glyphs which are scaled later and need exact proportions
+		bool activateFractionalSize( uint32_t pixels64 )
+		{
+			return activateSize( pixels64 | fractionalSize );
+		}
+
+		// Kerning of the glyph pair in font units
+		int getKernAdvance( int glyph1, int glyph2 )
+		{
+			if( !hasKerning )
+				return 0;
+			const uint64_t key = ( (uint64_t)( (uint32_t)glyph1 + 1 ) << 32 ) | (uint32_t)glyph2;
+			const int* cached = kerning.find( key );
+			if( nullptr != cached )
+				return *cached;
+			const int res = loadKernAdvance( glyph1, glyph2 );
+			*kerning.insert( key ) = res;
+			return res;
+		}
+	};
+
+	// The FreeType library is shared by all contexts of the process, and reference counted.
+	// Every successful freetypeInit() must be paired with freetypeDone(), the library is destroyed by the last one.
+	bool freetypeInit();
+
+	bool freetypeDone();
+
+	// Reference to the shared library for the scope, released by the destructor unless detach() is called
+	class FreetypeReference
+	{
+		bool held;
+
+	public:
+		FreetypeReference() : held( freetypeInit() ) { }
+		~FreetypeReference()
+		{
+			if( held )
+				freetypeDone();
+		}
+		FreetypeReference( const FreetypeReference& ) = delete;
+		void operator=( const FreetypeReference& ) = delete;
+
+		// False if the library failed to initialize
+		bool acquired() const
+		{
+			return held;
+		}
+
+		// Keep the reference after the scope, the owner calls freetypeDone() later
+		void detach()
+		{
+			held = false;
+		}
+	};
+
+	// Version of the FreeType library, major in the highest byte. The rendered glyphs depend on the version. 0 when the library is not initialized.
+	uint32_t freetypeVersion();
+}
\ No newline at end of file
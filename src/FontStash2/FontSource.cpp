@@ -0,0 +1,138 @@
+#include "FontSource.h"
+#include "FileHandles.h"
+#include <stdlib.h>
+#include <string>
+#include <map>
+#include <mutex>
+
+namespace FontStash2
+{
+	namespace
+	{
+		class MappedSource : public FontSource
+		{
+			MappedFile file;
+
+		public:
+			MappedSource( const char* path ) :
+				file( path )
+			{
+				m_data = file.data();
+				m_size = file.size();
+			}
+		};
+
+		class VectorSource : public FontSource
+		{
+			std::vector<uint8_t> vec;
+
+		public:
+			VectorSource( std::vector<uint8_t>& data )
+			{
+				vec.swap( data );
+				m_data = vec.data();
+				m_size = vec.size();
+			}
+		};
+
+		class MallocSource : public FontSource
+		{
+		public:
+			MallocSource( uint8_t* data, size_t size )
+			{
+				m_data = data;
+				m_size = size;
+			}
+
+			~MallocSource() override
+			{
+				free( (void*)m_data );
+			}
+		};
+
+		class ExternalSource : public FontSource
+		{
+		public:
+			ExternalSource( const uint8_t* data, size_t size )
+			{
+				m_data = data;
+				m_size = size;
+			}
+		};
+
+		// Weak references don't keep the files mapped, the entries expire when the last font which uses the file is destroyed
+		std::mutex mappedFilesLock;
+		std::map<std::string, std::weak_ptr<const FontSource>> mappedFiles;
+	}
+
+	std::shared_ptr<const FontSource> FontSource::mapFile( const char* path )
+	{
+		try
+		{
+			return mapFileLocked( path );
+		}
+		catch( const std::exception& )
+		{
+			return nullptr;
+		}
+	}
+
+	std::shared_ptr<const FontSource> FontSource::mapFileLocked( const char* path )
+	{
+		std::lock_guard<std::mutex> lock( mappedFilesLock );
+		std::weak_ptr<const FontSource>& entry = mappedFiles[ path ];
+		std::shared_ptr<const FontSource> res = entry.lock();
+		if( res )
+			return res;
+
+		// Drop the expired entries while we have the lock
+		for( auto it = mappedFiles.begin(); it != mappedFiles.end(); )
+		{
+			if( it->second.expired() && &it->second != &entry )
+				it = mappedFiles.erase( it );
+			else
+				++it;
+		}
+
+		auto mapped = std::make_shared<MappedSource>( path );
+		if( nullptr != mapped->data() )
+			res = std::move( mapped );
+		else
+		{
+			// Empty files can't be mapped, and some file systems don't support mapping
+			ReadFileHandle file{ path };
+			std::vector<uint8_t> data;
+			if( !file || !file.readAllBytes( data ) || data.empty() )
+			{
+				mappedFiles.erase( path );
+				return nullptr;
+			}
+			res = std::make_shared<VectorSource>( data );
+		}
+		entry = res;
+		return res;
+	}
+
+	std::shared_ptr<const FontSource> FontSource::fromVector( std::vector<uint8_t>& data )
+	{
+		return std::make_shared<VectorSource>( data );
+	}
+
+	std::shared_ptr<const FontSource> FontSource::fromMalloc( uint8_t* data, size_t size )
+	{
+		try
+		{
+			return std::make_shared<MallocSource>( data, size );
+		}
+		catch( const std::exception& )
+		{
+			free( data );
+			return nullptr;
+		}
+	}
+
+	std::shared_ptr<const FontSource> FontSource::fromExternal( const uint8_t* data, size_t size )
+	{
+		return std::make_shared<ExternalSource>( data, size );
+	}
+}
\ No newline at end of file
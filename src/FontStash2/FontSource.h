@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <memory>
+
+namespace FontStash2
+{
+	// Immutable bytes of a font file, the Font objects and FT_New_Memory_Face read them in place.
+	// Shared by reference counting, the memory is released when the last font which uses it is destroyed.
+	class FontSource
+	{
+	protected:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+
+		FontSource() = default;
+
+		static std::shared_ptr<const FontSource> mapFileLocked( const char* path );
+
+	public:
+		virtual ~FontSource() = default;
+
+		FontSource( const FontSource& ) = delete;
+		void operator=( const FontSource& ) = delete;
+
+		const uint8_t* data() const
+		{
+			return m_data;
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+
+		// Map the file into memory. Mappings are cached by path for the whole process, loading the same file
+		// in another context, or while the previous font is still alive, returns the existing mapping.
+		// Falls back to reading the file when it can't be mapped. Returns nullptr if the file can't be read.
+		static std::shared_ptr<const FontSource> mapFile( const char* path );
+
+		// Take the content of the vector, without copying. Throws std::bad_alloc when out of memory, so does fromExternal.
+		static std::shared_ptr<const FontSource> fromVector( std::vector<uint8_t>& data );
+
+		// Take ownership of a block allocated with malloc(), it's released with free(). Returns nullptr and frees the block when out of memory.
+		static std::shared_ptr<const FontSource> fromMalloc( uint8_t* data, size_t size );
+
+		// Reference the memory owned by the caller, which must stay valid until all fonts which use it are destroyed
+		static std::shared_ptr<const FontSource> fromExternal( const uint8_t* data, size_t size );
+	};
+}
\ No newline at end of file
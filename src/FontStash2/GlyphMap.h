@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+#include "FlatMap.hpp"
+
+namespace FontStash2
+{
+	struct GlyphValue
+	{
+		uint32_t index;
+		short x0, y0, x1, y1;
+		short xadv, xoff, yoff;
+		// Index of the atlas page with the bitmap
+		unsigned short page;
+		// Frame number when the bitmap was last used, for LRU eviction
+		uint32_t lastUsed;
+
+		bool hasBitmap() const
+		{
+			return x0 >= 0 && y0 >= 0;
+		}
+	};
+
+	// Key for the hash map, (codepoint, size, blur, subpixel phase) tuple packed into a single 64-bit integer.
+	// Blur takes the lower 8 bits of the last 16, it never exceeds 20. The phase is the horizontal offset of the bitmap in 1/8 of a pixel.
+	// The distance field glyphs have distanceField flag in the phase byte, the size is the reference size, and the blur byte keeps the spread.
+	// Codepoints take the lower 21 bits of the first 32. The keys of the glyphs across all fonts keep the font index in the 11 bits above them,
+	// see withFont(), the caches of the fonts leave them 0.
+	struct GlyphKey
+	{
+		uint64_t bits;
+
+		static constexpr int phaseSteps = 8;
+		static constexpr short distanceField = 0x80;
+		static constexpr int fontShift = 21;
+		static constexpr int maxFonts = 1 << ( 32 - fontShift );
+
+		GlyphKey() = default;
+
+		GlyphKey( unsigned int cp, short s, short b, short phase = 0 ) :
+			bits( (uint64_t)cp | ( (uint64_t)(uint16_t)s << 32 ) | ( (uint64_t)(uint8_t)b << 48 ) | ( (uint64_t)(uint8_t)phase << 56 ) ) { }
+
+		explicit GlyphKey( uint64_t b ) :
+			bits( b ) { }
+
+		bool operator == ( const GlyphKey &k ) const
+		{
+			return bits == k.bits;
+		}
+
+		unsigned int codepoint() const
+		{
+			return (unsigned int)bits & ( ( 1u << fontShift ) - 1 );
+		}
+		// The same key with the font index, unique across the fonts of the context
+		GlyphKey withFont( int font ) const
+		{
+			return GlyphKey{ bits | ( (uint64_t)(uint32_t)font << fontShift ) };
+		}
+		short size() const
+		{
+			return (short)( bits >> 32 );
+		}
+		short blur() const
+		{
+			return (short)(uint8_t)( bits >> 48 );
+		}
+		short phase() const
+		{
+			return (short)(uint8_t)( bits >> 56 ) & ~distanceField;
+		}
+		bool isDistanceField() const
+		{
+			return 0 != ( ( bits >> 56 ) & distanceField );
+		}
+		// (size, blur, phase) tuple packed into 32 bits
+		uint32_t sizeBlur() const
+		{
+			return (uint32_t)( bits >> 32 );
+		}
+	};
+
+	// Hash map which maps (codepoint, size, blur) tuples into GlyphValue structures.
+	// Zero key is never inserted because Context::getGlyph rejects sizes < 2.
+	class GlyphMap : public FlatMap<GlyphValue>
+	{
+		using Base = FlatMap<GlyphValue>;
+
+	public:
+
+		// Lookup a glyph, returns nullptr if not found
+		GlyphValue* find( const GlyphKey& k ) const
+		{
+			return Base::find( k.bits );
+		}
+
+		// Find or insert a glyph. Values of the newly inserted glyphs are zero-initialized.
+		GlyphValue* insert( const GlyphKey& k )
+		{
+			return Base::insert( k.bits );
+		}
+
+		// Call the functor for every glyph in the map, the arguments are ( GlyphKey, GlyphValue& )
+		template<class Func>
+		void forEach( Func fn )
+		{
+			Base::forEach( [ &fn ]( uint64_t key, GlyphValue& value ) { fn( GlyphKey{ key }, value ); } );
+		}
+	};
+}
\ No newline at end of file
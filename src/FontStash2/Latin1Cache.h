@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include "GlyphMap.h"
+
+namespace FontStash2
+{
+	// Direct-indexed glyph cache for codepoints [ 0 .. 255 ], for a few most recently used (size, blur, phase) tuples.
+	// Most of the text is ASCII at a few fixed sizes, for that text the lookup is a single indexed load, no hashing nor probing.
+	// The pointers point inside GlyphMap, the owner must clear this cache when the map is cleared or reallocated.
+	class Latin1Cache
+	{
+		// Subpixel positioning alternates between the phases glyph by glyph, there must be enough pages for all of them at a couple of sizes
+		static constexpr uint32_t countPages = 8;
+
+		struct Page
+		{
+			// GlyphKey::sizeBlur of the glyphs on this page, 0 for unused pages
+			uint32_t sizeBlur;
+			GlyphValue* glyphs[ 256 ];
+		};
+		std::array<Page, countPages> pages;
+		// Index of the most recently used page, checked first
+		uint32_t lastPage = 0;
+		// Index of the page to evict when all of them are in use
+		uint32_t nextVictim = 0;
+
+		Page* findPage( uint32_t sizeBlur )
+		{
+			if( pages[ lastPage ].sizeBlur == sizeBlur )
+				return &pages[ lastPage ];
+			for( uint32_t i = 0; i < countPages; i++ )
+			{
+				if( pages[ i ].sizeBlur != sizeBlur )
+					continue;
+				lastPage = i;
+				return &pages[ i ];
+			}
+			return nullptr;
+		}
+
+	public:
+
+		Latin1Cache()
+		{
+			clear();
+		}
+
+		static bool covers( unsigned int codepoint )
+		{
+			return codepoint < 256;
+		}
+
+		// Lookup a glyph, returns nullptr if not cached. The codepoint must be < 256.
+		GlyphValue* lookup( const GlyphKey& k )
+		{
+			const Page* const p = findPage( k.sizeBlur() );
+			if( nullptr == p )
+				return nullptr;
+			return p->glyphs[ k.codepoint() ];
+		}
+
+		// Remember the pointer. The codepoint must be < 256.
+		void store( const GlyphKey& k, GlyphValue* v )
+		{
+			Page* p = findPage( k.sizeBlur() );
+			if( nullptr == p )
+			{
+				lastPage = nextVictim;
+				nextVictim = ( nextVictim + 1 ) % countPages;
+				p = &pages[ lastPage ];
+				p->sizeBlur = k.sizeBlur();
+				std::fill( std::begin( p->glyphs ), std::end( p->glyphs ), nullptr );
+			}
+			p->glyphs[ k.codepoint() ] = v;
+		}
+
+		void clear()
+		{
+			for( Page& p : pages )
+				p.sizeBlur = 0;
+			lastPage = 0;
+			nextVictim = 0;
+		}
+	};
+}
\ No newline at end of file
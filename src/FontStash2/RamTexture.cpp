@@ -2,6 +2,7 @@
 #include "Font.h"
 #include "blur.h"
 #include "truevision.h"
+#include <string.h>
 
 namespace FontStash2
 {
@@ -20,6 +21,23 @@ namespace FontStash2
 		return true;
 	}
 
+	template<class T>
+	bool RamTexture<T>::assign( int width, int height, const uint8_t* pixels )
+	{
+		std::vector<T> data;
+		try
+		{
+			data.resize( (size_t)width * height );
+		}
+		catch( const std::exception& )
+		{
+			return false;
+		}
+		memcpy( data.data(), pixels, data.size() * sizeof( T ) );
+		texture.swap( data );
+		return true;
+	}
+
 	template<class T>
 	bool RamTexture<T>::expand( int oldWidth, int oldHeight, int width, int height )
 	{
@@ -61,6 +79,54 @@ namespace FontStash2
 		}
 	}
 
+	template<class T>
+	void RamTexture<T>::clearRect( int width, int gx, int gy, int w, int h )
+	{
+		T *dst = &texture[ gx + gy * width ];
+		for( int y = 0; y < h; y++ )
+		{
+			std::fill_n( dst, w, (T)0 );
+			dst += width;
+		}
+	}
+
+	template<class T>
+	void RamTexture<T>::copyRect( const RamTexture& source, int width, int sx, int sy, int w, int h, int dx, int dy )
+	{
+		const T* src = &source.texture[ sx + sy * width ];
+		T* dst = &texture[ dx + dy * width ];
+		for( int y = 0; y < h; y++ )
+		{
+			std::copy_n( src, w, dst );
+			src += width;
+			dst += width;
+		}
+	}
+
+	template<class T>
+	void RamTexture<T>::readRect( int width, int gx, int gy, int w, int h, T* dst ) const
+	{
+		const T* src = &texture[ gx + gy * width ];
+		for( int y = 0; y < h; y++ )
+		{
+			std::copy_n( src, w, dst );
+			src += width;
+			dst += w;
+		}
+	}
+
+	template<class T>
+	void RamTexture<T>::writeRect( int width, int gx, int gy, int w, int h, const T* src )
+	{
+		T* dst = &texture[ gx + gy * width ];
+		for( int y = 0; y < h; y++ )
+		{
+			std::copy_n( src, w, dst );
+			src += w;
+			dst += width;
+		}
+	}
+
 	template<class T>
 	bool RamTexture<T>::addGlyph( Font& font, int textureWidth, const GlyphValue* glyph, int pad )
 	{
@@ -70,19 +136,7 @@ namespace FontStash2
 		const int h = glyph->y1 - y;
 		T* dst = &texture[ x + pad + ( y + pad )* textureWidth ];
 		font.renderGlyphBitmap( dst, w - pad * 2, h - pad * 2, textureWidth );
-
-		// Make sure there is one pixel empty border.
-		dst = &texture[ x + y * textureWidth ];
-		for( int y = 0; y < h; y++ )
-		{
-			dst[ y * textureWidth ] = 0;
-			dst[ w - 1 + y * textureWidth ] = 0;
-		}
-		for( int x = 0; x < w; x++ )
-		{
-			dst[ x ] = 0;
-			dst[ x + ( h - 1 ) * textureWidth ] = 0;
-		}
+		clearBorder( textureWidth, glyph );
 
 		// Debug code to color the glyph background
 		/*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
@@ -96,6 +150,33 @@ namespace FontStash2
 		return true;
 	}
 
+	template<class T>
+	bool RamTexture<T>::addGlyph( const GlyphBitmap& bitmap, int textureWidth, const GlyphValue* glyph, int pad )
+	{
+		T* dst = &texture[ glyph->x0 + pad + ( glyph->y0 + pad ) * textureWidth ];
+		Font::renderGlyphBitmap( bitmap, dst, textureWidth );
+		clearBorder( textureWidth, glyph );
+		return true;
+	}
+
+	template<class T>
+	void RamTexture<T>::clearBorder( int textureWidth, const GlyphValue* glyph )
+	{
+		const int w = glyph->x1 - glyph->x0;
+		const int h = glyph->y1 - glyph->y0;
+		T* dst = &texture[ glyph->x0 + glyph->y0 * textureWidth ];
+		for( int y = 0; y < h; y++ )
+		{
+			dst[ y * textureWidth ] = 0;
+			dst[ w - 1 + y * textureWidth ] = 0;
+		}
+		for( int x = 0; x < w; x++ )
+		{
+			dst[ x ] = 0;
+			dst[ x + ( h - 1 ) * textureWidth ] = 0;
+		}
+	}
+
 #ifdef NANOVG_CLEARTYPE
 	template<>
 	bool RamTexture<uint32_t>::save( int w, int h, const char* path ) const
@@ -103,13 +184,57 @@ namespace FontStash2
 		return Truevision::saveColor( texture.data(), w, h, path );
 	}
 
+	template<>
+	void RamTexture<uint32_t>::blurRectangle( int textureWidth, int x, int y, int w, int h, short iblur, BlurScratch& scratch )
+	{
+		// Sub-pixel blur is pointless for shadows, blur the coverage, and store it into all 4 channels
+		std::vector<uint8_t>& gray = scratch.gray;
+		gray.resize( (size_t)w * h );
+		uint32_t* const rect = &texture[ x + y * textureWidth ];
+		for( int r = 0; r < h; r++ )
+		{
+			const uint32_t* src = rect + r * textureWidth;
+			for( int c = 0; c < w; c++ )
+			{
+				const uint32_t px = src[ c ];
+				gray[ r * w + c ] = (uint8_t)( ( ( px & 0xFF ) + ( ( px >> 8 ) & 0xFF ) + ( ( px >> 16 ) & 0xFF ) ) / 3 );
+			}
+		}
+		FontStash2::blur( gray.data(), w, h, w, iblur, scratch.transposed );
+		for( int r = 0; r < h; r++ )
+		{
+			uint32_t* dst = rect + r * textureWidth;
+			for( int c = 0; c < w; c++ )
+				dst[ c ] = gray[ r * w + c ] * 0x01010101u;
+		}
+	}
+
+	template<>
+	void RamTexture<uint32_t>::writeGrayRect( int width, int gx, int gy, int w, int h, const uint8_t* src )
+	{
+		uint32_t* dst = &texture[ gx + gy * width ];
+		for( int y = 0; y < h; y++ )
+		{
+			for( int x = 0; x < w; x++ )
+				dst[ x ] = src[ x ] * 0x01010101u;
+			src += w;
+			dst += width;
+		}
+	}
+
 	template class RamTexture<uint32_t>;
 #else
 	template<>
-	void RamTexture<uint8_t>::blurRectangle( int textureWidth, int x, int y, int w, int h, short iblur )
+	void RamTexture<uint8_t>::blurRectangle( int textureWidth, int x, int y, int w, int h, short iblur, BlurScratch& scratch )
 	{
 		unsigned char* bdst = &texture[ x + y * textureWidth ];
-		FontStash2::blur( bdst, w, h, textureWidth, iblur );
+		FontStash2::blur( bdst, w, h, textureWidth, iblur, scratch.transposed );
+	}
+
+	template<>
+	void RamTexture<uint8_t>::writeGrayRect( int width, int gx, int gy, int w, int h, const uint8_t* src )
+	{
+		writeRect( width, gx, gy, w, h, src );
 	}
 
 	template<>
@@ -1,11 +1,14 @@
 #pragma once
+#include <stdint.h>
 #include <vector>
 #include <algorithm>
+#include "blur.h"
 
 namespace FontStash2
 {
 	class Font;
 	struct GlyphValue;
+	struct GlyphBitmap;
 
 	// A 2D texture in system RAM
 	template<class T>
@@ -13,6 +16,9 @@ namespace FontStash2
 	{
 		std::vector<T> texture;
 
+		// Make sure there is one pixel empty border around the glyph
+		void clearBorder( int textureWidth, const GlyphValue* glyph );
+
 	public:
 
 		const T* data() const
@@ -22,13 +28,32 @@ namespace FontStash2
 
 		bool resize( int width, int height );
 
+		// Replace the texture with width * height texels copied from the memory, which doesn't have to be aligned
+		bool assign( int width, int height, const uint8_t* pixels );
+
 		bool expand( int oldWidth, int oldHeight, int width, int height );
 
 		void addWhiteRect( int width, int gx, int gy, int w, int h );
 
+		// Zero the rectangle, used when evicting glyphs
+		void clearRect( int width, int gx, int gy, int w, int h );
+
+		// Copy the w*h rectangle from another texture of the same width, used when compacting the atlas
+		void copyRect( const RamTexture& source, int width, int sx, int sy, int w, int h, int dx, int dy );
+
 		bool addGlyph( Font& font, int textureWidth, const GlyphValue* glyph, int pad );
 
-		void blurRectangle( int textureWidth, int x, int y, int w, int h, short iblur ) { }
+		// Same as above, for a glyph rendered in advance, possibly on another thread
+		bool addGlyph( const GlyphBitmap& bitmap, int textureWidth, const GlyphValue* glyph, int pad );
+
+		// Copy the rectangle out of the texture, and back into another place, used to make the blurred glyphs from the sharp ones
+		void readRect( int width, int gx, int gy, int w, int h, T* dst ) const;
+		void writeRect( int width, int gx, int gy, int w, int h, const T* src );
+		// Copy 8-bit values into the rectangle, ClearType builds store them into all 4 channels
+		void writeGrayRect( int width, int gx, int gy, int w, int h, const uint8_t* src );
+
+		// Defined for both texel types, the ClearType one blurs grayscale coverage, the average of the sub-pixels
+		void blurRectangle( int textureWidth, int x, int y, int w, int h, short iblur, BlurScratch& scratch );
 
 		bool save( int w, int h, const char* path ) const;
 	};
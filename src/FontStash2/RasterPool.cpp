@@ -0,0 +1,115 @@
+#include "RasterPool.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace FontStash2
+{
+	RasterFaces::RasterFaces()
+	{
+		library = freetypeNewLibrary();
+	}
+
+	RasterFaces::~RasterFaces()
+	{
+		for( auto& f : faces )
+			FT_Done_Face( f.second );
+		if( nullptr != library )
+			FT_Done_FreeType( library );
+	}
+
+	FT_Face RasterFaces::getFace( const Font* font )
+	{
+		for( const auto& f : faces )
+			if( f.first == font )
+				return f.second;
+		if( nullptr == library )
+			return nullptr;
+		FT_Face face = font->createFace( library );
+		if( nullptr != face )
+			faces.emplace_back( font, face );
+		return face;
+	}
+
+	void RasterFaces::rasterize( RasterJob& job )
+	{
+		FT_Face face = getFace( job.font );
+		job.ok = nullptr != face && job.font->rasterizeGlyph( face, job.glyph, job.size, job.phase, job.bitmap );
+	}
+
+	RasterPool::RasterPool( int threadsCount )
+	{
+		nextJob = 0;
+		states.resize( threadsCount );
+		for( auto& s : states )
+			s = std::make_unique<RasterFaces>();
+		threads.reserve( threadsCount - 1 );
+		for( int i = 1; i < threadsCount; i++ )
+			threads.emplace_back( &RasterPool::workerMain, this, (size_t)i );
+	}
+
+	RasterPool::~RasterPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			quit = true;
+		}
+		startBatch.notify_all();
+		for( auto& t : threads )
+			t.join();
+	}
+
+	void RasterPool::process( RasterFaces& faces )
+	{
+		std::vector<RasterJob>& batch = *jobs;
+		while( true )
+		{
+			const size_t i = nextJob.fetch_add( 1 );
+			if( i >= batch.size() )
+				return;
+			faces.rasterize( batch[ i ] );
+		}
+	}
+
+	void RasterPool::workerMain( size_t index )
+	{
+		uint64_t seen = 0;
+		while( true )
+		{
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				startBatch.wait( lock, [ & ] { return quit || generation != seen; } );
+				if( quit )
+					return;
+				seen = generation;
+			}
+
+			process( *states[ index ] );
+
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+				pending--;
+			}
+			batchDone.notify_one();
+		}
+	}
+
+	void RasterPool::run( std::vector<RasterJob>& batch )
+	{
+		if( batch.empty() )
+			return;
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			jobs = &batch;
+			nextJob = 0;
+			pending = threads.size();
+			generation++;
+		}
+		startBatch.notify_all();
+
+		process( *states[ 0 ] );
+
+		std::unique_lock<std::mutex> lock( mutex );
+		batchDone.wait( lock, [ this ] { return 0 == pending; } );
+		jobs = nullptr;
+	}
+}
\ No newline at end of file
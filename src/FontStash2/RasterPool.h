@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Font.h"
+
+namespace FontStash2
+{
+	// A glyph to rasterize on the worker threads
+	struct RasterJob
+	{
+		// The font which has the glyph, can be a fallback font
+		const Font* font;
+		uint32_t glyph;
+		float size;
+		// The key of the glyph in the cache of the base font
+		unsigned int codepoint;
+		// The base font, only set for AsyncRasterizer, the batches of RasterPool are all of the same font
+		Font* cacheFont;
+		short isize, iblur, phase;
+		// Output of the job
+		GlyphBitmap bitmap;
+		bool ok;
+	};
+
+	// FreeType library of a rasterizing thread, and the faces it created for the fonts.
+	// FreeType objects are not thread safe, every thread uses its own FT_Library, and creates own FT_Face for each font it renders.
+	// The faces are created over the source data owned by the Font objects, so the fonts must outlive this object.
+	class RasterFaces
+	{
+		FT_Library library = nullptr;
+		// Created on demand. There're very few fonts, linear search is fine.
+		std::vector<std::pair<const Font*, FT_Face>> faces;
+
+		FT_Face getFace( const Font* font );
+
+	public:
+		// When the library fails to initialize, all jobs fail, and the context renders these glyphs on the calling thread.
+		RasterFaces();
+		~RasterFaces();
+		RasterFaces( const RasterFaces& ) = delete;
+		void operator=( const RasterFaces& ) = delete;
+
+		// Sets job.ok and job.bitmap
+		void rasterize( RasterJob& job );
+	};
+
+	// Rasterizes batches of glyphs in parallel. Every thread has its own RasterFaces, so the fonts must outlive the pool.
+	class RasterPool
+	{
+		// Element 0 is for the thread which calls run(), the rest of them are for the workers
+		std::vector<std::unique_ptr<RasterFaces>> states;
+		std::vector<std::thread> threads;
+
+		std::mutex mutex;
+		std::condition_variable startBatch, batchDone;
+		std::vector<RasterJob>* jobs = nullptr;
+		// Incremented for every batch, workers wait for the change
+		uint64_t generation = 0;
+		// Count of workers still running on the current batch
+		size_t pending = 0;
+		bool quit = false;
+		std::atomic<size_t> nextJob;
+
+		void workerMain( size_t index );
+		void process( RasterFaces& faces );
+
+	public:
+
+		// The count includes the calling thread, i.e. threadsCount = 4 creates 3 worker threads.
+		RasterPool( int threadsCount );
+		~RasterPool();
+		RasterPool( const RasterPool& ) = delete;
+		void operator=( const RasterPool& ) = delete;
+
+		int threadsCount() const
+		{
+			return (int)states.size();
+		}
+
+		// Rasterize all the jobs. The calling thread participates, the method returns after all jobs are complete.
+		void run( std::vector<RasterJob>& batch );
+	};
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "ShelfPacker.h"
+#include <algorithm>
+using namespace FontStash2;
+
+void ShelfPacker::reset( int w, int h )
+{
+	width = w;
+	height = h;
+	top = 0;
+	shelves.clear();
+	openShelves.clear();
+	freeSlots.clear();
+	emptyShelves.clear();
+}
+
+void ShelfPacker::expand( int w, int h )
+{
+	// Shelves span the complete width, they all get longer
+	width = w;
+	height = h;
+}
+
+void ShelfPacker::reserveClass( int c )
+{
+	if( c < (int)openShelves.size() )
+		return;
+	openShelves.resize( c + 1, -1 );
+	freeSlots.resize( c + 1 );
+}
+
+int ShelfPacker::findShelf( const std::vector<Shelf>& shelves, int y )
+{
+	const auto it = std::lower_bound( shelves.begin(), shelves.end(), y, []( const Shelf& s, int v ) { return s.y < v; } );
+	if( it == shelves.end() || it->y != y )
+		return -1;
+	return (int)( it - shelves.begin() );
+}
+
+int ShelfPacker::findEmptyShelf( int c, bool exact ) const
+{
+	// The smallest one tall enough, wastes the least
+	int best = -1;
+	for( int i : emptyShelves )
+	{
+		const int hc = heightClass( shelves[ i ].height );
+		if( hc < c || ( exact && hc != c ) )
+			continue;
+		if( best < 0 || shelves[ i ].height < shelves[ best ].height )
+			best = i;
+	}
+	return best;
+}
+
+bool ShelfPacker::classHasRoom( int c, int rw ) const
+{
+	for( const Slot& s : freeSlots[ c ] )
+		if( s.width >= rw )
+			return true;
+	const int open = openShelves[ c ];
+	return open >= 0 && shelves[ open ].cursor + rw <= width;
+}
+
+bool ShelfPacker::addToClass( int c, int rw, int* rx, int* ry )
+{
+	// Space released by the evicted glyphs. Usually the last slot fits, the glyphs of a class have similar widths.
+	std::vector<Slot>& slots = freeSlots[ c ];
+	for( int i = (int)slots.size() - 1; i >= 0; i-- )
+	{
+		Slot& s = slots[ i ];
+		if( s.width < rw )
+			continue;
+		*rx = s.x;
+		*ry = shelves[ s.shelf ].y;
+		if( s.width > rw )
+		{
+			s.x += (short)rw;
+			s.width -= (short)rw;
+		}
+		else
+		{
+			s = slots.back();
+			slots.pop_back();
+		}
+		reusedCount++;
+		return true;
+	}
+
+	// Append to the open shelf
+	const int open = openShelves[ c ];
+	if( open < 0 || shelves[ open ].cursor + rw > width )
+		return false;
+	Shelf& shelf = shelves[ open ];
+	*rx = shelf.cursor;
+	*ry = shelf.y;
+	shelf.cursor += (short)rw;
+	return true;
+}
+
+bool ShelfPacker::canAdd( int rw, int rh ) const
+{
+	if( rw > width || rh > height || rw <= 0 || rh <= 0 )
+		return false;
+	const int c = heightClass( rh );
+	if( top + c * granularity <= height )
+		return true;
+	for( int t = c; t <= lastSharedClass( c ); t++ )
+		if( classHasRoom( t, rw ) )
+			return true;
+	return findEmptyShelf( c, false ) >= 0;
+}
+
+bool ShelfPacker::addRect( int rw, int rh, int* rx, int* ry )
+{
+	if( rw > width || rh > height || rw <= 0 || rh <= 0 )
+		return false;
+	const int c = heightClass( rh );
+	reserveClass( c );
+	if( addToClass( c, rw, rx, ry ) )
+		return true;
+
+	// Start another shelf of this class: an empty one, or a new one at the top
+	int open = findEmptyShelf( c, true );
+	if( open < 0 && top + c * granularity <= height )
+	{
+		open = (int)shelves.size();
+		shelves.push_back( Shelf{ (short)top, (short)( c * granularity ), 0 } );
+		top += c * granularity;
+	}
+	if( open < 0 )
+	{
+		// The atlas is full, share the shelves of the slightly taller classes before wasting a complete empty shelf
+		for( int t = c + 1; t <= lastSharedClass( c ); t++ )
+			if( addToClass( t, rw, rx, ry ) )
+				return true;
+		open = findEmptyShelf( c, false );
+		if( open < 0 )
+			return false;
+	}
+	const auto it = std::find( emptyShelves.begin(), emptyShelves.end(), open );
+	if( it != emptyShelves.end() )
+	{
+		emptyShelves.erase( it );
+		reusedCount++;
+	}
+	openShelves[ c ] = open;
+	return addToClass( c, rw, rx, ry );
+}
+
+void ShelfPacker::freeRect( int x, int y, int w )
+{
+	const int i = findShelf( shelves, y );
+	if( i < 0 )
+		return;
+	Shelf& shelf = shelves[ i ];
+	const int c = heightClass( shelf.height );
+	reserveClass( c );
+	std::vector<Slot>& slots = freeSlots[ c ];
+
+	// Merge with the free slots of the same shelf on both sides
+	int x0 = x, x1 = x + w;
+	for( bool merged = true; merged; )
+	{
+		merged = false;
+		for( size_t k = 0; k < slots.size(); k++ )
+		{
+			const Slot& s = slots[ k ];
+			if( s.shelf != i || ( s.x + s.width != x0 && s.x != x1 ) )
+				continue;
+			x0 = std::min( x0, (int)s.x );
+			x1 = std::max( x1, s.x + s.width );
+			slots[ k ] = slots.back();
+			slots.pop_back();
+			merged = true;
+			break;
+		}
+	}
+
+	// Space at the end of the shelf goes back to the cursor
+	if( x1 == shelf.cursor )
+	{
+		shelf.cursor = (short)x0;
+		releaseIfEmpty( i );
+	}
+	else
+		slots.push_back( Slot{ (short)i, (short)x0, (short)( x1 - x0 ) } );
+}
+
+void ShelfPacker::releaseIfEmpty( int shelf )
+{
+	if( shelves[ shelf ].cursor != 0 )
+		return;
+	for( int& open : openShelves )
+		if( open == shelf )
+			open = -1;
+	emptyShelves.push_back( shelf );
+}
+
+int ShelfPacker::getFreeArea() const
+{
+	int res = ( height - top ) * width;
+	for( const Shelf& s : shelves )
+		res += ( width - s.cursor ) * s.height;
+	forEachFreeSlot( [ &res ]( int, int, int w, int h ) { res += w * h; } );
+	return res;
+}
+
+bool ShelfPacker::isValidShelves( int w, int h, const std::vector<Shelf>& shelves )
+{
+	int y = 0;
+	for( const Shelf& s : shelves )
+	{
+		if( s.y != y || s.height <= 0 || s.height % granularity != 0 || s.cursor < 0 || s.cursor > w )
+			return false;
+		y += s.height;
+	}
+	return y <= h;
+}
+
+void ShelfPacker::restore( int w, int h, const std::vector<Shelf>& newShelves )
+{
+	reset( w, h );
+	shelves = newShelves;
+	if( !shelves.empty() )
+		top = shelves.back().y + shelves.back().height;
+
+	// Every class appends to its last shelf, the empty shelves are available to all of them
+	for( int i = 0; i < (int)shelves.size(); i++ )
+	{
+		const int c = heightClass( shelves[ i ].height );
+		reserveClass( c );
+		if( shelves[ i ].cursor == 0 )
+			emptyShelves.push_back( i );
+		else
+			openShelves[ c ] = i;
+	}
+}
+
+bool ShelfPacker::isValidFreeSlot( const std::vector<Shelf>& shelves, int x, int y, int w, int h )
+{
+	const int i = findShelf( shelves, y );
+	return i >= 0 && shelves[ i ].height == h && x >= 0 && w > 0 && x + w <= shelves[ i ].cursor;
+}
+
+bool ShelfPacker::restoreFreeSlot( int x, int y, int w, int h )
+{
+	if( !isValidFreeSlot( shelves, x, y, w, h ) )
+		return false;
+	const int i = findShelf( shelves, y );
+	freeSlots[ heightClass( h ) ].push_back( Slot{ (short)i, (short)x, (short)w } );
+	return true;
+}
\ No newline at end of file
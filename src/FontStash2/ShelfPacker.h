@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+namespace FontStash2
+{
+	// Shelf allocator for the atlas. Every shelf spans the complete width of the atlas and holds glyphs of a single height class,
+	// the heights are rounded up to a multiple of ShelfPacker::granularity. New glyphs are appended to the open shelf of their class,
+	// the shelves are stacked from the top of the atlas. Evicted glyphs leave free slots in their shelf, reused by glyphs of the same class.
+	// Glyph traffic is dominated by a few sizes, these only touch a few shelves, and the allocation is constant time.
+	class ShelfPacker
+	{
+	public:
+		// Shelf heights are multiples of that many pixels
+		static constexpr int granularity = 4;
+
+		struct Shelf
+		{
+			short y, height;
+			// The shelf is used from 0 to cursor, except the free slots
+			short cursor;
+		};
+
+		// Free space in a shelf, released by the evicted glyphs
+		struct Slot
+		{
+			short shelf, x, width;
+		};
+
+		void reset( int w, int h );
+
+		void expand( int w, int h );
+
+		bool addRect( int rw, int rh, int* rx, int* ry );
+
+		// Release the rectangle of an evicted glyph. The rectangle must be the one returned by addRect(), its height is the height of the shelf at y.
+		void freeRect( int x, int y, int w );
+
+		// True if addRect() would succeed
+		bool canAdd( int rw, int rh ) const;
+
+		// Bottom of the lowest shelf
+		int getTop() const
+		{
+			return top;
+		}
+
+		// Space available for new glyphs: above the shelves, after their cursors, and the free slots
+		int getFreeArea() const;
+
+		// Count of addRect() calls which reused a free slot or an empty shelf
+		int getReusedCount() const
+		{
+			return reusedCount;
+		}
+
+		const std::vector<Shelf>& getShelves() const
+		{
+			return shelves;
+		}
+
+		// Call the functor for every free slot, the arguments are ( int x, int y, int width, int height )
+		template<class Func>
+		void forEachFreeSlot( Func fn ) const
+		{
+			for( const auto& list : freeSlots )
+				for( const Slot& s : list )
+					fn( s.x, shelves[ s.shelf ].y, s.width, shelves[ s.shelf ].height );
+		}
+
+		// True if the shelves are stacked from the top of the w*h atlas without gaps, with heights which are multiples of the granularity, and cursors within the width.
+		static bool isValidShelves( int w, int h, const std::vector<Shelf>& shelves );
+
+		// True if the rectangle is a valid free slot for the shelves: within the used part of a shelf, with the height of that shelf
+		static bool isValidFreeSlot( const std::vector<Shelf>& shelves, int x, int y, int w, int h );
+
+		// Index of the shelf at that Y coordinate, or -1
+		static int findShelf( const std::vector<Shelf>& shelves, int y );
+
+		// Replace the state with the one loaded from a cache file, the shelves must pass isValidShelves() test
+		void restore( int w, int h, const std::vector<Shelf>& shelves );
+
+		// Add a free slot loaded from a cache file, after restore(). Returns false if the rectangle is not within the used part of a shelf.
+		bool restoreFreeSlot( int x, int y, int w, int h );
+
+	private:
+		int width = 0, height = 0;
+		int top = 0;
+		std::vector<Shelf> shelves;
+		// Index of the shelf where the glyphs of the height class are appended, or -1
+		std::vector<int> openShelves;
+		// Free slots for every height class
+		std::vector<std::vector<Slot>> freeSlots;
+		// Shelves with nothing allocated, any class not taller than the shelf may take them
+		std::vector<int> emptyShelves;
+		int reusedCount = 0;
+
+		static int heightClass( int h )
+		{
+			return ( h + granularity - 1 ) / granularity;
+		}
+
+		// Resize the per-class vectors to include the class
+		void reserveClass( int c );
+
+		// Last class which may take space from the shelves of the taller classes, wastes up to a quarter of the height plus one step
+		int lastSharedClass( int c ) const
+		{
+			return std::min( (int)openShelves.size() - 1, c + c / 4 + 1 );
+		}
+
+		// True if a free slot or the open shelf of the class has room for the width
+		bool classHasRoom( int c, int rw ) const;
+
+		// Allocate from a free slot or the open shelf of the class, returns false if none of them has room
+		bool addToClass( int c, int rw, int* rx, int* ry );
+
+
+		// Index of the empty shelf to take for the class, or -1. Only the shelves of that very class when exact is true.
+		int findEmptyShelf( int c, bool exact ) const;
+
+		// Mark the shelf as empty when everything allocated there was released
+		void releaseIfEmpty( int shelf );
+	};
+}
\ No newline at end of file
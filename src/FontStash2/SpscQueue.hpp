@@ -0,0 +1,72 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include <utility>
+
+namespace FontStash2
+{
+	// Bounded lock-free queue for a single producer thread and a single consumer thread.
+	// The slots are a ring buffer, the producer only writes tail, the consumer only writes head, the elements are moved in and out.
+	template<class T>
+	class SpscQueue
+	{
+		std::vector<T> slots;
+		// slots.size() - 1, the capacity is a power of 2
+		size_t mask;
+		// Both are incremented forever, the difference is the count of elements.
+		// Padded to separate cache lines, otherwise the two threads invalidate each other's line on every push and pop.
+		std::atomic<size_t> head;
+		char padHead[ 64 ];
+		std::atomic<size_t> tail;
+		char padTail[ 64 ];
+
+	public:
+		// The capacity is rounded up to a power of 2
+		SpscQueue( size_t capacity )
+		{
+			size_t c = 1;
+			while( c < capacity )
+				c *= 2;
+			slots.resize( c );
+			mask = c - 1;
+			head = 0;
+			tail = 0;
+		}
+		SpscQueue( const SpscQueue& ) = delete;
+		void operator=( const SpscQueue& ) = delete;
+
+		size_t capacity() const
+		{
+			return slots.size();
+		}
+
+		// Producer thread only. Returns false when the queue is full.
+		bool push( T&& value )
+		{
+			const size_t t = tail.load( std::memory_order_relaxed );
+			if( t - head.load( std::memory_order_acquire ) >= slots.size() )
+				return false;
+			slots[ t & mask ] = std::move( value );
+			tail.store( t + 1, std::memory_order_release );
+			return true;
+		}
+
+		// Consumer thread only. Returns false when the queue is empty.
+		bool pop( T& value )
+		{
+			const size_t h = head.load( std::memory_order_relaxed );
+			if( h == tail.load( std::memory_order_acquire ) )
+				return false;
+			value = std::move( slots[ h & mask ] );
+			head.store( h + 1, std::memory_order_release );
+			return true;
+		}
+
+		// Consumer thread only
+		bool empty() const
+		{
+			return head.load( std::memory_order_relaxed ) == tail.load( std::memory_order_acquire );
+		}
+	};
+}
\ No newline at end of file
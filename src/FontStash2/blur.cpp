@@ -1,10 +1,15 @@
 #include "blur.h"
 #include <math.h>
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define FONS_BLUR_SSE2
+#endif
 
 // Based on Exponential blur, Jani Huhtanen, 2006
 #define APREC 16
 #define ZPREC 7
 
+#ifndef FONS_BLUR_SSE2
 static void fons__blurCols( unsigned char* dst, int w, int h, int dstStride, int alpha )
 {
 	int x, y;
@@ -24,6 +29,7 @@ static void fons__blurCols( unsigned char* dst, int w, int h, int dstStride, int
 		dst += dstStride;
 	}
 }
+#endif
 
 static void fons__blurRows( unsigned char* dst, int w, int h, int dstStride, int alpha )
 {
@@ -45,7 +51,143 @@ static void fons__blurRows( unsigned char* dst, int w, int h, int dstStride, int
 	}
 }
 
-void FontStash2::blur( unsigned char* dst, int w, int h, int dstStride, int blur )
+#ifdef FONS_BLUR_SSE2
+namespace
+{
+	// The filter state z is within [ 0, 255 << ZPREC ], and so is the difference from the input, both fit in 16 bits.
+	// ( alpha * d ) >> APREC is the high half of the 16-bit product. Alpha may not fit in a signed 16-bit number,
+	// then it's multiplied as alpha - 65536, and d added back: the 65536 * d term is exact in the high half.
+	struct Alpha
+	{
+		__m128i mul;
+		bool addDiff;
+
+		Alpha( int alpha )
+		{
+			addDiff = alpha >= 0x8000;
+			mul = _mm_set1_epi16( (short)( addDiff ? alpha - 0x10000 : alpha ) );
+		}
+	};
+
+	template<bool addDiff>
+	inline __m128i filterStep( __m128i z, __m128i pixels16, __m128i mul )
+	{
+		const __m128i d = _mm_sub_epi16( _mm_slli_epi16( pixels16, ZPREC ), z );
+		__m128i step = _mm_mulhi_epi16( d, mul );
+		if( addDiff )
+			step = _mm_add_epi16( step, d );
+		return _mm_add_epi16( z, step );
+	}
+
+	// Vertical pass over 16 * VECS columns of fons__blurRows, the columns are independent chains which hide the latency of the multiplication.
+	template<int VECS, bool addDiff>
+	void blurRowsBlock( unsigned char* dst, int h, int dstStride, __m128i mul )
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo[ VECS ], hi[ VECS ];
+		for( int pass = 0; pass < 2; pass++ )
+		{
+			for( int v = 0; v < VECS; v++ )
+			{
+				lo[ v ] = zero;
+				hi[ v ] = zero;
+			}
+			// Forward from the second row, then backward from the second to last one
+			const int first = pass == 0 ? 1 : h - 2;
+			const int step = pass == 0 ? 1 : -1;
+			for( int y = first, i = 1; i < h; y += step, i++ )
+			{
+				unsigned char* row = dst + y * dstStride;
+				for( int v = 0; v < VECS; v++ )
+				{
+					const __m128i px = _mm_loadu_si128( (const __m128i*)( row + v * 16 ) );
+					lo[ v ] = filterStep<addDiff>( lo[ v ], _mm_unpacklo_epi8( px, zero ), mul );
+					hi[ v ] = filterStep<addDiff>( hi[ v ], _mm_unpackhi_epi8( px, zero ), mul );
+					_mm_storeu_si128( (__m128i*)( row + v * 16 ), _mm_packus_epi16( _mm_srli_epi16( lo[ v ], ZPREC ), _mm_srli_epi16( hi[ v ], ZPREC ) ) );
+				}
+			}
+			// Force zero border
+			unsigned char* border = dst + ( pass == 0 ? h - 1 : 0 ) * dstStride;
+			for( int v = 0; v < VECS; v++ )
+				_mm_storeu_si128( (__m128i*)( border + v * 16 ), zero );
+		}
+	}
+
+	template<bool addDiff>
+	void blurRowsSimd( unsigned char* dst, int w, int h, int dstStride, int alpha, __m128i mul )
+	{
+		int x = 0;
+		for( ; x + 32 <= w; x += 32 )
+			blurRowsBlock<2, addDiff>( dst + x, h, dstStride, mul );
+		for( ; x + 16 <= w; x += 16 )
+			blurRowsBlock<1, addDiff>( dst + x, h, dstStride, mul );
+		if( x < w )
+			fons__blurRows( dst + x, w - x, h, dstStride, alpha );
+	}
+
+	// Same result as fons__blurRows
+	void blurRows( unsigned char* dst, int w, int h, int dstStride, int alpha, const Alpha& a )
+	{
+		if( h < 2 )
+			fons__blurRows( dst, w, h, dstStride, alpha );
+		else if( a.addDiff )
+			blurRowsSimd<true>( dst, w, h, dstStride, alpha, a.mul );
+		else
+			blurRowsSimd<false>( dst, w, h, dstStride, alpha, a.mul );
+	}
+
+	// Transpose in 16x16 tiles, the tail rows and columns one byte at a time
+	void transpose( const unsigned char* src, int w, int h, int srcStride, unsigned char* dst, int dstStride )
+	{
+		int y = 0;
+		for( ; y + 16 <= h; y += 16 )
+		{
+			int x = 0;
+			for( ; x + 16 <= w; x += 16 )
+			{
+				__m128i r[ 16 ];
+				for( int i = 0; i < 16; i++ )
+					r[ i ] = _mm_loadu_si128( (const __m128i*)( src + ( y + i ) * srcStride + x ) );
+				// 4 rounds of interleaving, every round doubles the width of the transposed elements
+				for( int i = 0; i < 8; i++ )
+				{
+					const __m128i a = r[ i * 2 ], b = r[ i * 2 + 1 ];
+					r[ i * 2 ] = _mm_unpacklo_epi8( a, b );
+					r[ i * 2 + 1 ] = _mm_unpackhi_epi8( a, b );
+				}
+				__m128i t[ 16 ];
+				for( int i = 0; i < 4; i++ )
+					for( int j = 0; j < 2; j++ )
+					{
+						t[ i * 4 + j * 2 ] = _mm_unpacklo_epi16( r[ i * 4 + j ], r[ i * 4 + j + 2 ] );
+						t[ i * 4 + j * 2 + 1 ] = _mm_unpackhi_epi16( r[ i * 4 + j ], r[ i * 4 + j + 2 ] );
+					}
+				for( int i = 0; i < 2; i++ )
+					for( int j = 0; j < 4; j++ )
+					{
+						r[ i * 8 + j * 2 ] = _mm_unpacklo_epi32( t[ i * 8 + j ], t[ i * 8 + j + 4 ] );
+						r[ i * 8 + j * 2 + 1 ] = _mm_unpackhi_epi32( t[ i * 8 + j ], t[ i * 8 + j + 4 ] );
+					}
+				for( int j = 0; j < 8; j++ )
+				{
+					t[ j * 2 ] = _mm_unpacklo_epi64( r[ j ], r[ j + 8 ] );
+					t[ j * 2 + 1 ] = _mm_unpackhi_epi64( r[ j ], r[ j + 8 ] );
+				}
+				for( int i = 0; i < 16; i++ )
+					_mm_storeu_si128( (__m128i*)( dst + ( x + i ) * dstStride + y ), t[ i ] );
+			}
+			for( ; x < w; x++ )
+				for( int i = 0; i < 16; i++ )
+					dst[ x * dstStride + y + i ] = src[ ( y + i ) * srcStride + x ];
+		}
+		for( ; y < h; y++ )
+			for( int x = 0; x < w; x++ )
+				dst[ x * dstStride + y ] = src[ y * srcStride + x ];
+	}
+}
+#endif
+
+void FontStash2::blur( unsigned char* dst, int w, int h, int dstStride, int blur, std::vector<uint8_t>& scratch )
 {
 	int alpha;
 	float sigma;
@@ -55,10 +197,25 @@ void FontStash2::blur( unsigned char* dst, int w, int h, int dstStride, int blur
 	// Calculate the alpha such that 90% of the kernel is within the radius. (Kernel extends to infinity)
 	sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
 	alpha = (int)( ( 1 << APREC ) * ( 1.0f - expf( -2.3f / ( sigma + 1.0f ) ) ) );
+#ifdef FONS_BLUR_SSE2
+	// The horizontal passes run as vertical ones on the transposed glyph, to filter many rows at once with contiguous loads
+	const Alpha a{ alpha };
+	scratch.resize( (size_t)w * h );
+	unsigned char* const t = scratch.data();
+	blurRows( dst, w, h, dstStride, alpha, a );
+	transpose( dst, w, h, dstStride, t, h );
+	blurRows( t, h, w, h, alpha, a );
+	transpose( t, h, w, h, dst, dstStride );
+	blurRows( dst, w, h, dstStride, alpha, a );
+	transpose( dst, w, h, dstStride, t, h );
+	blurRows( t, h, w, h, alpha, a );
+	transpose( t, h, w, h, dst, dstStride );
+#else
 	fons__blurRows( dst, w, h, dstStride, alpha );
 	fons__blurCols( dst, w, h, dstStride, alpha );
 	fons__blurRows( dst, w, h, dstStride, alpha );
 	fons__blurCols( dst, w, h, dstStride, alpha );
+#endif
 	//	fons__blurrows( dst, w, h, dstStride, alpha );
 	//	fons__blurcols( dst, w, h, dstStride, alpha );
 }
\ No newline at end of file
@@ -1,6 +1,18 @@
 #pragma once
+#include <stdint.h>
+#include <vector>
 
 namespace FontStash2
 {
-	void blur( unsigned char* dst, int w, int h, int dstStride, int blur );
+	// Buffers reused between the blurred glyphs
+	struct BlurScratch
+	{
+		// Passed to blur() below
+		std::vector<uint8_t> transposed;
+		// Grayscale copy of the rectangle in ClearType builds
+		std::vector<uint8_t> gray;
+	};
+
+	// The scratch buffer holds a transposed copy of the w*h rectangle when the SIMD version is used
+	void blur( unsigned char* dst, int w, int h, int dstStride, int blur, std::vector<uint8_t>& scratch );
 }
\ No newline at end of file
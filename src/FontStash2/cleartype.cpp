@@ -0,0 +1,93 @@
+#include "cleartype.h"
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define FONS_CLEARTYPE_NEON
+#elif defined( __SSSE3__ )
+#include <tmmintrin.h>
+#define FONS_CLEARTYPE_SSSE3
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define FONS_CLEARTYPE_SSE2
+#endif
+
+namespace
+{
+#if defined( FONS_CLEARTYPE_SSSE3 ) || defined( FONS_CLEARTYPE_SSE2 )
+	// 4 pixels, RGB in the low 3 bytes of every 32-bit lane. Sets alpha to the maximum of them.
+	inline __m128i addAlpha( __m128i rgb )
+	{
+		__m128i m = _mm_max_epu8( rgb, _mm_srli_epi32( rgb, 8 ) );
+		m = _mm_max_epu8( m, _mm_srli_epi32( rgb, 16 ) );
+		return _mm_or_si128( rgb, _mm_slli_epi32( m, 24 ) );
+	}
+
+	// Spread 4 RGB triples from the low 12 bytes into the 32-bit lanes, the high bytes are zero
+	inline __m128i spreadTriples( __m128i v )
+	{
+#ifdef FONS_CLEARTYPE_SSSE3
+		const __m128i shuffle = _mm_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+		return _mm_shuffle_epi8( v, shuffle );
+#else
+		const __m128i lane0 = _mm_setr_epi32( 0xFFFFFF, 0, 0, 0 );
+		const __m128i lane1 = _mm_setr_epi32( 0, 0xFFFFFF, 0, 0 );
+		const __m128i lane2 = _mm_setr_epi32( 0, 0, 0xFFFFFF, 0 );
+		const __m128i lane3 = _mm_setr_epi32( 0, 0, 0, 0xFFFFFF );
+		__m128i res = _mm_and_si128( v, lane0 );
+		res = _mm_or_si128( res, _mm_and_si128( _mm_slli_si128( v, 1 ), lane1 ) );
+		res = _mm_or_si128( res, _mm_and_si128( _mm_slli_si128( v, 2 ), lane2 ) );
+		return _mm_or_si128( res, _mm_and_si128( _mm_slli_si128( v, 3 ), lane3 ) );
+#endif
+	}
+
+	// 16 pixels, 48 bytes in, 64 bytes out
+	inline uint32_t packBlocks( uint32_t* dst, const uint8_t* src, uint32_t count )
+	{
+		uint32_t i = 0;
+		for( ; i + 16 <= count; i += 16, src += 48, dst += 16 )
+		{
+			const __m128i a = _mm_loadu_si128( (const __m128i*)src );
+			const __m128i b = _mm_loadu_si128( (const __m128i*)( src + 16 ) );
+			const __m128i c = _mm_loadu_si128( (const __m128i*)( src + 32 ) );
+			// Bytes 0-11, 12-23, 24-35 and 36-47 of the 48
+			const __m128i p0 = a;
+			const __m128i p1 = _mm_or_si128( _mm_srli_si128( a, 12 ), _mm_slli_si128( b, 4 ) );
+			const __m128i p2 = _mm_or_si128( _mm_srli_si128( b, 8 ), _mm_slli_si128( c, 8 ) );
+			const __m128i p3 = _mm_srli_si128( c, 4 );
+			_mm_storeu_si128( (__m128i*)dst, addAlpha( spreadTriples( p0 ) ) );
+			_mm_storeu_si128( (__m128i*)( dst + 4 ), addAlpha( spreadTriples( p1 ) ) );
+			_mm_storeu_si128( (__m128i*)( dst + 8 ), addAlpha( spreadTriples( p2 ) ) );
+			_mm_storeu_si128( (__m128i*)( dst + 12 ), addAlpha( spreadTriples( p3 ) ) );
+		}
+		return i;
+	}
+#elif defined( FONS_CLEARTYPE_NEON )
+	inline uint32_t packBlocks( uint32_t* dst, const uint8_t* src, uint32_t count )
+	{
+		uint32_t i = 0;
+		for( ; i + 16 <= count; i += 16, src += 48, dst += 16 )
+		{
+			const uint8x16x3_t rgb = vld3q_u8( src );
+			uint8x16x4_t rgba;
+			rgba.val[ 0 ] = rgb.val[ 0 ];
+			rgba.val[ 1 ] = rgb.val[ 1 ];
+			rgba.val[ 2 ] = rgb.val[ 2 ];
+			rgba.val[ 3 ] = vmaxq_u8( vmaxq_u8( rgb.val[ 0 ], rgb.val[ 1 ] ), rgb.val[ 2 ] );
+			vst4q_u8( (uint8_t*)dst, rgba );
+		}
+		return i;
+	}
+#else
+	inline uint32_t packBlocks( uint32_t* dst, const uint8_t* src, uint32_t count )
+	{
+		return 0;
+	}
+#endif
+}
+
+void FontStash2::packClearTypeRow( uint32_t* dst, const uint8_t* src, uint32_t count )
+{
+	// The vector code assumes little endian RGBA in memory, which all the targets with these instruction sets are
+	const uint32_t done = packBlocks( dst, src, count );
+	for( uint32_t i = done; i < count; i++ )
+		dst[ i ] = packClearTypePixel( src + i * 3 );
+}
\ No newline at end of file
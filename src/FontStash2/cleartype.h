@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+namespace FontStash2
+{
+	// Convert a row of FreeType LCD output, 3 grayscale sub-pixel bytes per pixel, into RGBA pixels. Alpha is the maximum of the 3 sub-pixels.
+	// Uses SSSE3, SSE2 or NEON when the compiler targets them, the results are the same as packClearTypePixel.
+	void packClearTypeRow( uint32_t* dst, const uint8_t* src, uint32_t count );
+
+	inline uint32_t packClearTypePixel( const uint8_t* triple )
+	{
+		uint8_t a = triple[ 0 ] > triple[ 1 ] ? triple[ 0 ] : triple[ 1 ];
+		a = a > triple[ 2 ] ? a : triple[ 2 ];
+		return (uint32_t)triple[ 0 ] | ( (uint32_t)triple[ 1 ] << 8 ) | ( (uint32_t)triple[ 2 ] << 16 ) | ( (uint32_t)a << 24 );
+	}
+}
\ No newline at end of file
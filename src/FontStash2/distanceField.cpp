@@ -0,0 +1,106 @@
+#include "distanceField.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	constexpr float infinity = 1e20f;
+
+	// 1D squared distance transform of length values at the stride, in place. f, z and v have at least length + 1 elements.
+	void transform1d( float* grid, int stride, int length, float* f, float* z, int* v )
+	{
+		for( int q = 0; q < length; q++ )
+			f[ q ] = grid[ q * stride ];
+
+		// Lower envelope of the parabolas rooted at every sample
+		v[ 0 ] = 0;
+		z[ 0 ] = -infinity;
+		z[ 1 ] = infinity;
+		int k = 0;
+		for( int q = 1; q < length; q++ )
+		{
+			float s;
+			do
+			{
+				const int r = v[ k ];
+				s = ( f[ q ] - f[ r ] + (float)( q * q - r * r ) ) / (float)( q - r ) * 0.5f;
+			}
+			while( s <= z[ k ] && --k >= 0 );
+			k++;
+			v[ k ] = q;
+			z[ k ] = s;
+			z[ k + 1 ] = infinity;
+		}
+
+		k = 0;
+		for( int q = 0; q < length; q++ )
+		{
+			while( z[ k + 1 ] < (float)q )
+				k++;
+			const int r = v[ k ];
+			grid[ q * stride ] = f[ r ] + (float)( ( q - r ) * ( q - r ) );
+		}
+	}
+
+	void transform2d( float* grid, int w, int h, FontStash2::DistanceFieldScratch& s )
+	{
+		for( int x = 0; x < w; x++ )
+			transform1d( grid + x, w, h, s.f.data(), s.z.data(), s.v.data() );
+		for( int y = 0; y < h; y++ )
+			transform1d( grid + y * w, 1, w, s.f.data(), s.z.data(), s.v.data() );
+	}
+}
+
+void FontStash2::buildDistanceField( const uint8_t* coverage, int w, int h, int stride, int spread, uint8_t* dst, int dstStride, DistanceFieldScratch& scratch )
+{
+	const int fw = w + spread * 2;
+	const int fh = h + spread * 2;
+	const size_t area = (size_t)fw * fh;
+	const int length = std::max( fw, fh ) + 1;
+	scratch.outer.assign( area, infinity );
+	scratch.inner.assign( area, 0.0f );
+	scratch.f.resize( length );
+	scratch.z.resize( length + 1 );
+	scratch.v.resize( length );
+
+	// Outer grid has zeros inside the glyph, inner grid outside. The pixels with partial coverage are 0.5 - coverage away from the outline.
+	for( int y = 0; y < h; y++ )
+	{
+		const uint8_t* src = coverage + y * stride;
+		float* outer = &scratch.outer[ ( y + spread ) * fw + spread ];
+		float* inner = &scratch.inner[ ( y + spread ) * fw + spread ];
+		for( int x = 0; x < w; x++ )
+		{
+			const uint8_t c = src[ x ];
+			if( 0 == c )
+				continue;
+			if( 255 == c )
+			{
+				outer[ x ] = 0;
+				inner[ x ] = infinity;
+				continue;
+			}
+			const float d = 0.5f - (float)c * ( 1.0f / 255.0f );
+			outer[ x ] = d > 0 ? d * d : 0;
+			inner[ x ] = d < 0 ? d * d : 0;
+		}
+	}
+
+	transform2d( scratch.outer.data(), fw, fh, scratch );
+	transform2d( scratch.inner.data(), fw, fh, scratch );
+
+	const float mul = 127.0f / (float)spread;
+	for( int y = 0; y < fh; y++ )
+	{
+		const float* outer = &scratch.outer[ y * fw ];
+		const float* inner = &scratch.inner[ y * fw ];
+		uint8_t* line = dst + y * dstStride;
+		for( int x = 0; x < fw; x++ )
+		{
+			// Positive outside
+			const float d = sqrtf( outer[ x ] ) - sqrtf( inner[ x ] );
+			const float v = 128.0f - d * mul;
+			line[ x ] = (uint8_t)std::min( std::max( v + 0.5f, 0.0f ), 255.0f );
+		}
+	}
+}
\ No newline at end of file
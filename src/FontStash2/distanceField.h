@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace FontStash2
+{
+	// Buffers reused between the glyphs
+	struct DistanceFieldScratch
+	{
+		std::vector<float> outer, inner;
+		std::vector<float> f, z;
+		std::vector<int> v;
+	};
+
+	// Convert w*h 8-bit coverage into the signed distance field, (w + spread * 2) * (h + spread * 2) bytes written with dstStride.
+	// 128 is the outline, the values grow inside the glyph, spread pixels away from the outline are 0 outside and 255 inside.
+	// Exact euclidean distances by Felzenszwalb & Huttenlocher, the partially covered pixels place the outline between the pixel centers.
+	void buildDistanceField( const uint8_t* coverage, int w, int h, int stride, int spread, uint8_t* dst, int dstStride, DistanceFieldScratch& scratch );
+}
\ No newline at end of file
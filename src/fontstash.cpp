@@ -3,9 +3,11 @@
 #include "fontstash.h"
 #include "FontStash2/Context.h"
 #include "FontStash2/utf8.h"
-#include "FontStash2/FileHandles.h"
+#include "FontStash2/FontSource.h"
 using FontStash2::FONSstate;
+using FontStash2::FontSource;
 using FontStash2::GlyphValue;
+using FontStash2::GlyphKey;
 
 #define FONS_NOTUSED(v)  (void)sizeof(v)
 
@@ -14,9 +16,14 @@ FONScontext* fonsCreateInternal( FONSparams* params )
 {
 	try
 	{
+		// Released when the construction fails, fonsDeleteInternal releases it otherwise
+		FontStash2::FreetypeReference library;
+		if( !library.acquired() )
+			return nullptr;
 		auto up = std::make_unique<FONScontext>( params );
 		if( !up->initStuff() )
 			return nullptr;
+		library.detach();
 		return up.release();
 	}
 	catch( const std::exception& )
@@ -59,103 +66,63 @@ int fonsExpandAtlas( FONScontext* stash, int width, int height )
 	if( width == stash->params.width && height == stash->params.height )
 		return 1;
 
-	// Flush pending glyphs.
-	stash->flush();
-
-	// Create new texture
-	if( stash->params.renderResize != NULL ) {
-		if( stash->params.renderResize( stash->params.userPtr, width, height ) == 0 )
-			return 0;
-	}
-
-	if( !stash->ramTexture.expand( stash->params.width, stash->params.height, width, height ) )
-		return 0;
-
-	// Increase atlas size
-	stash->atlas.expand( width, height );
-
-	// Add existing data as dirty.
-	const int maxy = stash->atlas.getMaxY();
-	stash->dirtyRect[ 0 ] = 0;
-	stash->dirtyRect[ 1 ] = 0;
-	stash->dirtyRect[ 2 ] = stash->params.width;
-	stash->dirtyRect[ 3 ] = maxy;
-
-	stash->params.width = width;
-	stash->params.height = height;
-	stash->itw = 1.0f / stash->params.width;
-	stash->ith = 1.0f / stash->params.height;
-
-	return 1;
+	return stash->expandAtlas( width, height ) ? 1 : 0;
 }
 
 int fonsResetAtlas( FONScontext* stash, int width, int height )
 {
 	if( nullptr == stash )
 		return 0;
-
-	// Flush pending glyphs.
-	stash->flush();
-
-	// Create new texture
-	if( stash->params.renderResize != NULL )
-	{
-		if( stash->params.renderResize( stash->params.userPtr, width, height ) == 0 )
-			return 0;
-	}
-
-	// Reset atlas
-	stash->atlas.reset( width, height );
-
-	// Clear texture data
-	if( !stash->ramTexture.resize( width, height ) )
-		return 0;
-
-	// Reset dirty rect
-	stash->dirtyRect[ 0 ] = width;
-	stash->dirtyRect[ 1 ] = height;
-	stash->dirtyRect[ 2 ] = 0;
-	stash->dirtyRect[ 3 ] = 0;
-
-	// Reset cached glyphs
-	for( auto& f : stash->fonts )
-		f->reset();
-
-	stash->params.width = width;
-	stash->params.height = height;
-	stash->itw = 1.0f / stash->params.width;
-	stash->ith = 1.0f / stash->params.height;
-
-	// Add white rect at 0,0 for debug drawing.
-	stash->addWhiteRect( 2, 2 );
-	return 1;
+	return stash->resetAtlas( width, height ) ? 1 : 0;
 }
 
 // ===== Add fonts =====
 int fonsAddFont( FONScontext* stash, const char* name, const char* path )
 {
-	// Read in the font data.
-	ReadFileHandle file{ path };
-	if( !file )
-		return FONS_INVALID;
-
-	std::vector<uint8_t> data;
-	if( !file.readAllBytes( data ) )
+	if( nullptr == stash )
 		return FONS_INVALID;
 
-	return stash->addFont( name, data );
+	// Map the font data, or reuse the mapping when the file is already loaded
+	return stash->addFont( name, FontSource::mapFile( path ) );
 }
 
 int fonsAddFontMem( FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData )
 {
 	if( nullptr == stash )
+	{
+		if( freeData )
+			free( data );
 		return FONS_INVALID;
+	}
 
-	std::vector<uint8_t> dataVector{ data, data + dataSize };
+	// The font takes ownership of the memory when asked to free it, no need to copy
 	if( freeData )
-		free( data );
+		return stash->addFont( name, FontSource::fromMalloc( data, (size_t)dataSize ) );
 
-	return stash->addFont( name, dataVector );
+	try
+	{
+		std::vector<uint8_t> dataVector{ data, data + dataSize };
+		return stash->addFont( name, FontSource::fromVector( dataVector ) );
+	}
+	catch( const std::exception& )
+	{
+		return FONS_INVALID;
+	}
+}
+
+int fonsAddFontMemStatic( FONScontext* stash, const char* name, const unsigned char* data, int dataSize )
+{
+	if( nullptr == stash )
+		return FONS_INVALID;
+
+	try
+	{
+		return stash->addFont( name, FontSource::fromExternal( data, (size_t)dataSize ) );
+	}
+	catch( const std::exception& )
+	{
+		return FONS_INVALID;
+	}
 }
 
 int fonsGetFontByName( FONScontext* s, const char* name )
@@ -221,6 +188,13 @@ void fonsSetBlur( FONScontext* stash, float blur )
 	stash->getState()->blur = blur;
 }
 
+void fonsSetDistanceField( FONScontext* stash, int enabled )
+{
+	if( nullptr == stash )
+		return;
+	stash->getState()->distanceField = enabled ? 1 : 0;
+}
+
 void fonsSetAlign( FONScontext* stash, int align )
 {
 	if( nullptr == stash )
@@ -278,15 +252,35 @@ float fonsDrawText( FONScontext* stash, float x, float y, const char* str, const
 	// Align vertically.
 	y += stash->getVertAlign( font, state->align, isize );
 
+	short glyphSize;
+	const float glyphScale = stash->getGlyphScale( *state, glyphSize, true );
+	if( !state->distanceField )
+		stash->prefetchGlyphs( font, str, end, glyphSize, iblur );
+
 	for( ; str != end; ++str )
 	{
 		if( FontStash2::decodeUTF8( &utf8state, &codepoint, *(const unsigned char*)str ) )
 			continue;
-		glyph = stash->getGlyph( font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED );
+		// Differs from glyphScale for the glyphs substituted by getGlyphForFrame
+		float quadScale = glyphScale;
+		if( state->distanceField )
+			glyph = stash->getDistanceFieldGlyph( font, codepoint, FONS_GLYPH_BITMAP_REQUIRED );
+		else
+		{
+			// The scaled glyphs are not snapped to pixels, they don't need the phases
+			const short phase = ( 0 == glyphScale ) ? stash->getSubpixelPhase( font, prevGlyphIndex, codepoint, scale, state->spacing, x ) : 0;
+			glyph = stash->getGlyphForFrame( font, codepoint, glyphSize, iblur, phase, FONS_GLYPH_BITMAP_REQUIRED, quadScale );
+		}
 		if( glyph != NULL )
 		{
-			stash->getQuad( font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q );
+			stash->getQuad( font, prevGlyphIndex, glyph, scale, state->spacing, quadScale, &x, &y, &q );
 
+			// The vertices of a single draw call sample a single page
+			if( glyph->page != stash->drawPage )
+			{
+				stash->flush();
+				stash->drawPage = glyph->page;
+			}
 			if( stash->nverts + 6 > FONS_VERTEX_COUNT )
 				stash->flush();
 
@@ -341,14 +335,21 @@ float fonsTextBounds( FONScontext* stash, float x, float y, const char* str, con
 	if( end == NULL )
 		end = str + strlen( str );
 
+	short glyphSize;
+	const float glyphScale = stash->getGlyphScale( *state, glyphSize, false );
 	for( ; str != end; ++str )
 	{
 		if( FontStash2::decodeUTF8( &utf8state, &codepoint, *(const unsigned char*)str ) )
 			continue;
-		glyph = stash->getGlyph( font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_OPTIONAL );
+		// Measuring only needs the metrics, they're the same for all subpixel phases
+		float quadScale = glyphScale;
+		if( state->distanceField )
+			glyph = stash->getDistanceFieldGlyph( font, codepoint, FONS_GLYPH_BITMAP_OPTIONAL );
+		else
+			glyph = stash->getGlyphForFrame( font, codepoint, glyphSize, iblur, 0, FONS_GLYPH_BITMAP_OPTIONAL, quadScale );
 		if( glyph != NULL )
 		{
-			stash->getQuad( font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q );
+			stash->getQuad( font, prevGlyphIndex, glyph, scale, state->spacing, quadScale, &x, &y, &q );
 			if( q.x0 < minx ) minx = q.x0;
 			if( q.x1 > maxx ) maxx = q.x1;
 			if( stash->params.flags & FONS_ZERO_TOPLEFT ) {
@@ -453,14 +454,22 @@ int fonsTextIterInit( FONScontext* stash, FONStextIter* iter,
 	// Align vertically.
 	y += stash->getVertAlign( *iter->font, state->align, iter->isize );
 
+	// The glyphs may be rasterized at another size, the kerning and alignment use the size of the text
+	iter->glyphScale = stash->getGlyphScale( *state, iter->isize, bitmapOption == FONS_GLYPH_BITMAP_REQUIRED );
+	iter->distanceField = state->distanceField;
+
 	if( end == NULL )
 		end = str + strlen( str );
 
+	if( bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && !iter->distanceField )
+		stash->prefetchGlyphs( *iter->font, str, end, iter->isize, iter->iblur );
+
 	iter->x = iter->nextx = x;
 	iter->y = iter->nexty = y;
 	iter->spacing = state->spacing;
 	iter->str = str;
 	iter->next = str;
+	iter->page = 0;
 	iter->end = end;
 	iter->codepoint = 0;
 	iter->prevGlyphIndex = -1;
@@ -486,10 +495,22 @@ int fonsTextIterNext( FONScontext* stash, FONStextIter* iter, FONSquad* quad )
 		// Get glyph and quad
 		iter->x = iter->nextx;
 		iter->y = iter->nexty;
-		glyph = stash->getGlyph( *iter->font, iter->codepoint, iter->isize, iter->iblur, iter->bitmapOption );
+		float quadScale = iter->glyphScale;
+		if( iter->distanceField )
+			glyph = stash->getDistanceFieldGlyph( *iter->font, iter->codepoint, iter->bitmapOption );
+		else
+		{
+			short phase = 0;
+			if( iter->bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && 0 == iter->glyphScale )
+				phase = stash->getSubpixelPhase( *iter->font, iter->prevGlyphIndex, iter->codepoint, iter->scale, iter->spacing, iter->nextx );
+			glyph = stash->getGlyphForFrame( *iter->font, iter->codepoint, iter->isize, iter->iblur, phase, iter->bitmapOption, quadScale );
+		}
 		// If the iterator was initialized with FONS_GLYPH_BITMAP_OPTIONAL, then the UV coordinates of the quad will be invalid.
 		if( glyph != nullptr )
-			stash->getQuad( *iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad );
+		{
+			stash->getQuad( *iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, quadScale, &iter->nextx, &iter->nexty, quad );
+			iter->page = glyph->page;
+		}
 		iter->prevGlyphIndex = glyph != nullptr ? glyph->index : -1;
 		break;
 	}
@@ -509,25 +530,146 @@ const uint8_t* fonsGetTextureData( FONScontext* stash, int* width, int* height )
 		*width = stash->params.width;
 	if( height != NULL )
 		*height = stash->params.height;
-	return stash->ramTexture.data();
+	return stash->pages[ 0 ].texture.data();
 }
 
 int fonsValidateTexture( FONScontext* stash, int* dirty )
 {
-	if( stash->dirtyRect[ 0 ] < stash->dirtyRect[ 2 ] && stash->dirtyRect[ 1 ] < stash->dirtyRect[ 3 ] )
-	{
-		dirty[ 0 ] = stash->dirtyRect[ 0 ];
-		dirty[ 1 ] = stash->dirtyRect[ 1 ];
-		dirty[ 2 ] = stash->dirtyRect[ 2 ];
-		dirty[ 3 ] = stash->dirtyRect[ 3 ];
-		// Reset dirty rect
-		stash->dirtyRect[ 0 ] = stash->params.width;
-		stash->dirtyRect[ 1 ] = stash->params.height;
-		stash->dirtyRect[ 2 ] = 0;
-		stash->dirtyRect[ 3 ] = 0;
-		return 1;
-	}
-	return 0;
+	return fonsValidatePage( stash, 0, dirty );
+}
+
+int fonsValidateTextureRects( FONScontext* stash, int* rects, int maxRects )
+{
+	return fonsValidatePageRects( stash, 0, rects, maxRects );
+}
+
+int fonsSetMaxAtlasPages( FONScontext* stash, int pages )
+{
+	if( nullptr == stash || pages < 1 || pages > FONS_MAX_ATLAS_PAGES )
+		return 0;
+	stash->maxPages = pages;
+	return 1;
+}
+
+int fonsGetAtlasPageCount( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return 0;
+	return (int)stash->pages.size();
+}
+
+#ifdef NANOVG_CLEARTYPE
+const uint32_t* fonsGetPageData( FONScontext* stash, int page )
+#else
+const uint8_t* fonsGetPageData( FONScontext* stash, int page )
+#endif
+{
+	if( nullptr == stash || page < 0 || page >= (int)stash->pages.size() )
+		return nullptr;
+	return stash->pages[ page ].texture.data();
+}
+
+int fonsValidatePage( FONScontext* stash, int page, int* dirty )
+{
+	if( nullptr == stash || page < 0 || page >= (int)stash->pages.size() )
+		return 0;
+	// Bounding box of all the dirty rectangles
+	return stash->takeDirtyRects( page, dirty, 1 );
+}
+
+int fonsValidatePageRects( FONScontext* stash, int page, int* rects, int maxRects )
+{
+	if( nullptr == stash || page < 0 || page >= (int)stash->pages.size() )
+		return 0;
+	return stash->takeDirtyRects( page, rects, maxRects );
+}
+
+int fonsGetDrawPage( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->drawPage;
+}
+
+int fonsSetAtlasPacker( FONScontext* stash, int packer )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->setAtlasPacker( packer ) ? 1 : 0;
+}
+
+int fonsCompactAtlas( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->compactAtlas() ? 1 : 0;
+}
+
+float fonsGetAtlasFragmentation( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->getAtlasFragmentation();
+}
+
+int fonsSetAutoCompaction( FONScontext* stash, float threshold )
+{
+	if( nullptr == stash || !( threshold >= 0 && threshold < 1 ) )
+		return 0;
+	stash->compactThreshold = threshold;
+	return 1;
+}
+
+int fonsSetSubpixelPositioning( FONScontext* stash, int phases )
+{
+	if( nullptr == stash || phases < 1 || phases > GlyphKey::phaseSteps || 0 != ( phases & ( phases - 1 ) ) )
+		return 0;
+	// The phases are stored in 1/8 of a pixel, the glyphs cached with another count stay valid
+	stash->subpixelPhases = phases;
+	return 1;
+}
+
+int fonsSetDistanceFieldSize( FONScontext* stash, float size, int spread )
+{
+	if( nullptr == stash || !( size >= 8 && size <= 256 ) || spread < 1 || spread > 16 )
+		return 0;
+	// Both are in the keys of the glyphs, the ones rendered with other values are evicted when unused
+	stash->distanceFieldSize = size;
+	stash->distanceFieldSpread = spread;
+	return 1;
+}
+
+int fonsSetSizeBuckets( FONScontext* stash, float ratio, int settleFrames )
+{
+	if( nullptr == stash || !( ratio == 0 || ( ratio > 1 && ratio <= 2 ) ) || settleFrames < 0 )
+		return 0;
+	stash->sizeBucketRatio = ratio;
+	stash->sizeSettleFrames = settleFrames;
+	stash->sizeStreaks.clear();
+	return 1;
+}
+
+int fonsSetRasterBudget( FONScontext* stash, int glyphs, int microseconds )
+{
+	if( nullptr == stash || glyphs < 0 || microseconds < 0 )
+		return 0;
+	stash->frameGlyphBudget = glyphs;
+	stash->frameMicrosBudget = microseconds;
+	return 1;
+}
+
+int fonsSetAsyncRasterization( FONScontext* stash, int enabled )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->setAsyncRasterization( 0 != enabled ) ? 1 : 0;
+}
+
+int fonsGetUnfinishedGlyphs( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->frameUnfinished;
 }
 
 // ===== Miscellaneous =====
@@ -560,7 +702,7 @@ void fonsDrawDebug( FONScontext* stash, float x, float y )
 	stash->vertex( x + w, y + h, 1, 1, 0xffffffff );
 
 	// Drawbug draw atlas
-	for( const auto& n : stash->atlas.atlasNodes() )
+	for( const auto& n : stash->pages[ 0 ].atlas.atlasNodes() )
 	{
 		if( stash->nverts + 6 > FONS_VERTEX_COUNT )
 			stash->flush();
@@ -583,6 +725,70 @@ int fonsAddFallbackFont( FONScontext* stash, int base, int fallback )
 	return baseFont->tryAddFallback( fallback );
 }
 
+int fonsPrewarmGlyphs( FONScontext* stash, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, FONSprewarmStats* stats )
+{
+	FONSprewarmStats res = { 0, 0, 0 };
+	if( nullptr != stash && font >= 0 && font < (int)stash->fonts.size() && !stash->fonts[ font ]->empty() )
+		stash->prewarmGlyphs( *stash->fonts[ font ], *stash->getState(), sizes, nsizes, ranges, nranges, res );
+	if( nullptr != stash )
+		res.atlasFree = stash->getAtlasFreeArea();
+	if( nullptr != stats )
+		*stats = res;
+	return res.added;
+}
+
+int fonsSetRasterThreads( FONScontext* stash, int threads )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->setRasterThreads( threads ) ? 1 : 0;
+}
+
+int fonsSaveCache( FONScontext* stash, const char* path )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->saveCache( path ) ? 1 : 0;
+}
+
+int fonsLoadCache( FONScontext* stash, const char* path )
+{
+	if( nullptr == stash )
+		return 0;
+	return stash->loadCache( path ) ? 1 : 0;
+}
+
+void fonsNextFrame( FONScontext* stash )
+{
+	if( nullptr == stash )
+		return;
+	// Before the frame counter moves, so the glyphs of the frame which just ended are not evicted to make room for them
+	stash->collectAsyncGlyphs();
+	stash->frame++;
+	stash->atlasStats.lastFrameUploadBytes = stash->atlasStats.frameUploadBytes;
+	stash->atlasStats.frameUploadBytes = 0;
+	stash->compactIfFragmented();
+	stash->frameGlyphs = 0;
+	stash->frameRasterNanos = 0;
+	stash->frameUnfinished = 0;
+	stash->placeholders.clear();
+	stash->placeholderIndex.clear();
+	stash->finishDeferredGlyphs();
+}
+
+void fonsGetAtlasStats( FONScontext* stash, FONSatlasStats* stats )
+{
+	if( nullptr == stash || nullptr == stats )
+		return;
+	*stats = stash->atlasStats;
+	stats->rectsReused = 0;
+	stats->atlasFree = stash->getAtlasFreeArea();
+	for( const auto& p : stash->pages )
+		stats->rectsReused += p.atlas.getReusedCount();
+	stats->pages = (int)stash->pages.size();
+	stats->glyphsPending = (int)stash->deferredGlyphs.size() + stash->asyncInFlight;
+}
+
 int fonsDebugDumpAtlas( FONScontext* stash, const char* path )
 {
 	return stash->debugDumpAtlas( path );
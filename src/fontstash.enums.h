@@ -6,6 +6,14 @@ enum FONSflags
 	FONS_ZERO_BOTTOMLEFT = 2,
 };
 
+enum FONSatlasPacker
+{
+	// Bottom-left skyline, the tightest packing of mixed sizes
+	FONS_PACKER_SKYLINE = 0,
+	// Shelves of quantized glyph heights, constant time allocation, evicted glyphs leave slots for the glyphs of the same height
+	FONS_PACKER_SHELF = 1,
+};
+
 enum FONSglyphBitmap
 {
 	FONS_GLYPH_BITMAP_OPTIONAL = 1,
@@ -50,6 +50,9 @@ struct FONSquad
 struct FONStextIter
 {
 	float x, y, nextx, nexty, scale, spacing;
+	// Scale of the glyphs rasterized at another size than the text, 0 when they're drawn at their size. isize is the size of the glyphs.
+	float glyphScale;
+	int distanceField;
 	unsigned int codepoint;
 	short isize, iblur;
 	FONSfont* font;
@@ -59,6 +62,36 @@ struct FONStextIter
 	const char* end;
 	unsigned int utf8state;
 	int bitmapOption;
+	// Atlas page of the last glyph returned by fonsTextIterNext
+	int page;
+};
+
+struct FONSprewarmStats
+{
+	int added, atlasFull;
+	int atlasFree;
+};
+
+struct FONSatlasStats
+{
+	// Glyphs evicted from the atlas, and count of the eviction passes which evicted them
+	int glyphsEvicted, evictionPasses;
+	// Glyphs placed into rectangles released by the evicted glyphs
+	int rectsReused;
+	// Calls to fonsResetAtlas
+	int atlasResets;
+	// Space available for new glyphs on the current pages, in pixels
+	int atlasFree;
+	// Pages added to the atlas after the first one, and current count of the pages
+	int pagesAdded, pages;
+	// Calls to fonsCompactAtlas, and the automatic compactions
+	int compactions;
+	// Dirty rectangles passed to renderUpdate or pulled with fonsValidatePage, fonsValidatePageRects
+	int uploads;
+	// Bytes of these rectangles since the last fonsNextFrame, and in the frame before it
+	int frameUploadBytes, lastFrameUploadBytes;
+	// Glyphs deferred to later frames by the rasterization budget or submitted to the background thread, and the ones of them not in the atlas yet
+	int glyphsDeferred, glyphsPending;
 };
 
 // Constructor and destructor
@@ -74,8 +107,12 @@ int fonsExpandAtlas( FONScontext* s, int width, int height );
 int fonsResetAtlas( FONScontext* stash, int width, int height );
 
 // Add fonts
+// The file is memory mapped. Fonts loaded from the same path share the mapping, also across contexts.
 int fonsAddFont( FONScontext* s, const char* name, const char* path );
+// With freeData, the font takes ownership of the malloc-ed block and frees it when destroyed, otherwise the data is copied.
 int fonsAddFontMem( FONScontext* s, const char* name, unsigned char* data, int ndata, int freeData );
+// Doesn't copy the data, the caller must keep it alive until the context is deleted.
+int fonsAddFontMemStatic( FONScontext* s, const char* name, const unsigned char* data, int ndata );
 int fonsGetFontByName( FONScontext* s, const char* name );
 
 // State handling
@@ -90,6 +127,10 @@ void fonsSetSpacing( FONScontext* s, float spacing );
 void fonsSetBlur( FONScontext* s, float blur );
 void fonsSetAlign( FONScontext* s, int align );
 void fonsSetFont( FONScontext* s, int font );
+// Non-zero draws the text with the signed distance field glyphs, rendered once at the reference size and scaled to the size of the text.
+// The quads are not snapped to pixels, the renderer must draw them with a distance field shader, and the blur is ignored.
+// Zooming and animated sizes don't rasterize new glyphs; small text looks better with the bitmaps rendered at its size, which is the default.
+void fonsSetDistanceField( FONScontext* s, int enabled );
 
 // Draw text
 float fonsDrawText( FONScontext* s, float x, float y, const char* string, const char* end );
@@ -110,10 +151,93 @@ const uint32_t* fonsGetTextureData( FONScontext* stash, int* width, int* height
 const uint8_t* fonsGetTextureData( FONScontext* stash, int* width, int* height );
 #endif
 int fonsValidateTexture( FONScontext* s, int* dirty );
+// Same as fonsValidateTexture, with up to maxRects separate rectangles, 4 ints each, instead of one bounding box. Returns count of the rectangles.
+int fonsValidateTextureRects( FONScontext* stash, int* rects, int maxRects );
+
+// Allow the atlas to grow up to that many pages of the same size before evicting glyphs, default is 1. The first page is the one above.
+// Returns 0 if the value is out of range. Lowering the limit takes effect on the next fonsResetAtlas.
+int fonsSetMaxAtlasPages( FONScontext* stash, int pages );
+int fonsGetAtlasPageCount( FONScontext* stash );
+#ifdef NANOVG_CLEARTYPE
+const uint32_t* fonsGetPageData( FONScontext* stash, int page );
+#else
+const uint8_t* fonsGetPageData( FONScontext* stash, int page );
+#endif
+// Same as fonsValidateTexture, for the specified page
+int fonsValidatePage( FONScontext* stash, int page, int* dirty );
+int fonsValidatePageRects( FONScontext* stash, int page, int* rects, int maxRects );
+// Atlas page for the vertices passed to renderDraw callback. fonsDrawText flushes the vertices when the glyphs switch to another page.
+int fonsGetDrawPage( FONScontext* stash );
+
+// Select the rectangle allocator of the atlas, one of FONSatlasPacker values, the default is FONS_PACKER_SKYLINE.
+// Changing the packer resets the atlas. Returns 0 if the value is invalid, or if the reset failed.
+int fonsSetAtlasPacker( FONScontext* stash, int packer );
+
+// Repack the glyphs of the atlas tightly, reclaiming the holes left by the evicted glyphs. The pixels are moved without rasterizing the glyphs again, and pages left empty are dropped.
+// Texture coordinates of the glyphs change, call between frames. Needs memory for another copy of the pages. Returns 0 and keeps the atlas if failed.
+int fonsCompactAtlas( FONScontext* stash );
+// Share of the used atlas area not covered by the glyphs, between 0 and 1
+float fonsGetAtlasFragmentation( FONScontext* stash );
+// Compact the atlas in fonsNextFrame when the fragmentation is above the threshold, and some glyphs were evicted since the last compaction. 0 disables, this is the default.
+int fonsSetAutoCompaction( FONScontext* stash, float threshold );
+
+// Position the glyphs at fractions of a pixel horizontally, phases is 2, 4 or 8 positions per pixel, 1 disables, this is the default.
+// The advances and kerning are no longer rounded to whole pixels. Every glyph is rasterized at most once per phase, the phase nearest to the pen position.
+// fonsTextBounds and the text iterator with FONS_GLYPH_BITMAP_OPTIONAL measure the glyphs at phase 0. Returns 0 if the count is invalid.
+int fonsSetSubpixelPositioning( FONScontext* stash, int phases );
+
+// Reference size in pixels of the distance field glyphs, 8 to 256, and their spread, how many reference pixels the field extends outside of the outline, 1 to 16.
+// The default is 32 and 4. Larger sizes keep sharper corners, the text drawn smaller than size / spread gets aliased edges. Returns 0 if the values are invalid.
+int fonsSetDistanceFieldSize( FONScontext* stash, float size, int spread );
+
+// Rasterize the glyphs at the nearest size of a geometric ladder, 1, ratio, ratio^2 and so on, and scale their quads to the size of the text.
+// An animated size then rasterizes the few sizes of the ladder it passes, instead of every 0.1 pixel step. The ratio is above 1 and up to 2, 0 disables, this is the default.
+// The scaled glyphs are placed without snapping to pixels, and are slightly blurry. A size drawn in more than settleFrames consecutive frames
+// is rasterized exactly, as without the buckets; 0 always uses the buckets. Returns 0 if the values are invalid.
+int fonsSetSizeBuckets( FONScontext* stash, float ratio, int settleFrames );
+
+// Limit the glyphs rasterized per frame, by count and by the time spent in microseconds, 0 is no limit, this is the default for both.
+// Missing glyphs over the budget are queued, fonsNextFrame rasterizes them within the budget of the new frame. Meanwhile the text draws them
+// from a recently drawn size, scaled, or leaves them blank with their advance, so the layout barely moves when they arrive. The time limit is checked before every glyph.
+// Measuring the text loads the metrics without the budget, the bounds never depend on it.
+// The worker threads don't prefetch the glyphs while the budget is set. Returns 0 if the values are negative.
+int fonsSetRasterBudget( FONScontext* stash, int glyphs, int microseconds );
+
+// Rasterize the missing glyphs of the text on a background thread, with its own FreeType faces; disabled by default. The text draws them
+// like the glyphs over the rasterization budget, fonsNextFrame packs the finished ones into the atlas, the budget is not used while it's enabled.
+// Needs fonsNextFrame calls, without them no glyphs arrive. Distance field glyphs and fonsPrewarmGlyphs are still rendered on the calling thread,
+// and measuring the text loads the metrics of the missing glyphs there, without the bitmaps.
+// Returns 0 if failed to create the thread.
+int fonsSetAsyncRasterization( FONScontext* stash, int enabled );
+// Count of the glyphs drawn since the last fonsNextFrame with a substitute or blank, because they were not rasterized yet.
+// When it's not 0, draw the frame again later, to show the text with the complete glyphs.
+int fonsGetUnfinishedGlyphs( FONScontext* stash );
 
 // Draws the stash texture for debugging
 void fonsDrawDebug( FONScontext* s, float x, float y );
 
 int fonsAddFallbackFont( FONScontext* stash, int base, int fallback );
 
+// Rasterize glyphs into the atlas ahead of time. Ranges are 2*nranges codepoints, [first, last] pairs, inclusive.
+// Uses blur and the distance field mode from the current state, and the size buckets, the glyphs are the ones the text drawn with the state uses.
+// Returns count of glyphs added, stops when the atlas is full.
+int fonsPrewarmGlyphs( FONScontext* stash, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, FONSprewarmStats* stats );
+
+// Rasterize missing glyphs of text runs and prewarm requests on that many threads, including the calling one. 0 or 1 disables the worker threads.
+// Returns 0 if failed to create the threads.
+int fonsSetRasterThreads( FONScontext* stash, int threads );
+
+// Save the atlas texture and the cached glyphs of all fonts into a file.
+int fonsSaveCache( FONScontext* stash, const char* path );
+// Load the file written by fonsSaveCache, replacing the atlas. The fonts must be the same files added in the same order, with the same fallbacks.
+// Returns 0 and keeps the atlas if the file doesn't match the fonts, the FreeType version or the build. The whole atlas is marked dirty.
+int fonsLoadCache( FONScontext* stash, const char* path );
+
+// Advance the frame counter. Glyphs not used in the current frame may be evicted when the atlas is full, the least recently used first.
+// Without the calls, nothing is ever evicted, and full atlas is reported to the error callback as FONS_ATLAS_FULL.
+// Also compacts the atlas when enabled with fonsSetAutoCompaction, and adds the glyphs of the background thread or the rasterization budget.
+void fonsNextFrame( FONScontext* stash );
+// Get counters of the atlas, they are cumulative since the context was created
+void fonsGetAtlasStats( FONScontext* stash, FONSatlasStats* stats );
+
 int fonsDebugDumpAtlas( FONScontext* stash, const char* path );
\ No newline at end of file
@@ -36,6 +36,8 @@
 #define NVG_INIT_FONTIMAGE_SIZE  512
 #define NVG_MAX_FONTIMAGE_SIZE   2048
 #define NVG_MAX_FONTIMAGES       4
+#define NVG_MAX_FONT_PAGES       8
+#define NVG_MAX_FONT_DIRTY_RECTS 8
 
 #define NVG_INIT_COMMANDS_SIZE 256
 #define NVG_INIT_POINTS_SIZE 128
@@ -85,6 +87,7 @@ struct NVGstate {
 	float letterSpacing;
 	float lineHeight;
 	float fontBlur;
+	int fontDistanceField;
 	int textAlign;
 	int fontId;
 };
@@ -129,6 +132,11 @@ struct NVGcontext {
 	FONScontext* fs;
 	int fontImages[ NVG_MAX_FONTIMAGES ];
 	int fontImageIdx;
+	// Textures of the atlas pages after the first one, the first page uses fontImages[ fontImageIdx ]
+	int fontPageImages[ NVG_MAX_FONT_PAGES ];
+	// Page textures replaced by nvg__allocTextAtlas, the draw calls of this frame may still use them, deleted by nvgEndFrame
+	int retiredPageImages[ NVG_MAX_FONT_PAGES * NVG_MAX_FONTIMAGES ];
+	int nretiredPageImages;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
@@ -360,6 +368,15 @@ void nvgDeleteInternal( NVGcontext* ctx )
 			ctx->fontImages[ i ] = 0;
 		}
 	}
+	for( i = 0; i < NVG_MAX_FONT_PAGES; i++ ) {
+		if( ctx->fontPageImages[ i ] != 0 ) {
+			nvgDeleteImage( ctx, ctx->fontPageImages[ i ] );
+			ctx->fontPageImages[ i ] = 0;
+		}
+	}
+	for( i = 0; i < ctx->nretiredPageImages; i++ )
+		nvgDeleteImage( ctx, ctx->retiredPageImages[ i ] );
+	ctx->nretiredPageImages = 0;
 
 	if( ctx->params.renderDelete != NULL )
 		ctx->params.renderDelete( ctx->params.userPtr );
@@ -377,6 +394,9 @@ void nvgBeginFrame( NVGcontext* ctx, float windowWidth, float windowHeight, floa
 	nvgSave( ctx );
 	nvgReset( ctx );
 
+	// Glyphs drawn by the previous frames become candidates for eviction
+	fonsNextFrame( ctx->fs );
+
 	nvg__setDevicePixelRatio( ctx, devicePixelRatio );
 
 	ctx->params.renderViewport( ctx->params.userPtr, windowWidth, windowHeight, devicePixelRatio );
@@ -392,9 +412,17 @@ void nvgCancelFrame( NVGcontext* ctx )
 	ctx->params.renderCancel( ctx->params.userPtr );
 }
 
+static void nvg__flushTextTexture( NVGcontext* ctx );
+
 void nvgEndFrame( NVGcontext* ctx )
 {
+	int k;
+	// Upload the glyphs added by the frame, the back-end draws nothing before renderFlush
+	nvg__flushTextTexture( ctx );
 	ctx->params.renderFlush( ctx->params.userPtr );
+	for( k = 0; k < ctx->nretiredPageImages; k++ )
+		nvgDeleteImage( ctx, ctx->retiredPageImages[ k ] );
+	ctx->nretiredPageImages = 0;
 	if( ctx->fontImageIdx != 0 ) {
 		int fontImage = ctx->fontImages[ ctx->fontImageIdx ];
 		int i, j, iw, ih;
@@ -665,6 +693,7 @@ void nvgReset( NVGcontext* ctx )
 	state->letterSpacing = 0.0f;
 	state->lineHeight = 1.0f;
 	state->fontBlur = 0.0f;
+	state->fontDistanceField = 0;
 	state->textAlign = NVG_ALIGN_LEFT | NVG_ALIGN_BASELINE;
 	state->fontId = 0;
 }
@@ -2332,6 +2361,11 @@ int nvgCreateFontMem( NVGcontext* ctx, const char* name, unsigned char* data, in
 	return fonsAddFontMem( ctx->fs, name, data, ndata, freeData );
 }
 
+int nvgCreateFontMemStatic( NVGcontext* ctx, const char* name, const unsigned char* data, int ndata )
+{
+	return fonsAddFontMemStatic( ctx->fs, name, data, ndata );
+}
+
 int nvgFindFont( NVGcontext* ctx, const char* name )
 {
 	if( name == NULL ) return -1;
@@ -2363,6 +2397,12 @@ void nvgFontBlur( NVGcontext* ctx, float blur )
 	state->fontBlur = blur;
 }
 
+void nvgFontDistanceField( NVGcontext* ctx, int enabled )
+{
+	NVGstate* state = nvg__getState( ctx );
+	state->fontDistanceField = enabled;
+}
+
 void nvgTextLetterSpacing( NVGcontext* ctx, float spacing )
 {
 	NVGstate* state = nvg__getState( ctx );
@@ -2403,28 +2443,53 @@ static float nvg__getFontScale( NVGstate* state )
 	return nvg__minf( nvg__quantize( nvg__getAverageScale( state->xform ), 0.01f ), 4.0f );
 }
 
-static void nvg__flushTextTexture( NVGcontext* ctx )
+// Texture of the atlas page, created on first use. Returns 0 if failed.
+static int nvg__fontPageImage( NVGcontext* ctx, int page )
 {
-	int dirty[ 4 ];
+	int fw, fh, iw, ih;
+	if( page <= 0 )
+		return ctx->fontImages[ ctx->fontImageIdx ];
+	if( page >= NVG_MAX_FONT_PAGES )
+		return 0;
+	fonsGetAtlasSize( ctx->fs, &fw, &fh );
+	if( ctx->fontPageImages[ page ] != 0 ) {
+		nvgImageSize( ctx, ctx->fontPageImages[ page ], &iw, &ih );
+		if( iw == fw && ih == fh )
+			return ctx->fontPageImages[ page ];
+		// The atlas was expanded or reset to another size
+		if( ctx->nretiredPageImages < NVG_MAX_FONT_PAGES * NVG_MAX_FONTIMAGES )
+			ctx->retiredPageImages[ ctx->nretiredPageImages++ ] = ctx->fontPageImages[ page ];
+		else
+			nvgDeleteImage( ctx, ctx->fontPageImages[ page ] );
+	}
+	ctx->fontPageImages[ page ] = ctx->params.renderCreateTexture( ctx->params.userPtr, fontAtlasTextureType, fw, fh, 0, NULL );
+	return ctx->fontPageImages[ page ];
+}
 
-	if( fonsValidateTexture( ctx->fs, dirty ) ) {
-		int fontImage = ctx->fontImages[ ctx->fontImageIdx ];
-		// Update texture
-		if( fontImage != 0 ) {
-			int iw, ih;
-			const unsigned char* data = (const unsigned char*)fonsGetTextureData( ctx->fs, &iw, &ih );
-			int x = dirty[ 0 ];
-			int y = dirty[ 1 ];
-			int w = dirty[ 2 ] - dirty[ 0 ];
-			int h = dirty[ 3 ] - dirty[ 1 ];
-			ctx->params.renderUpdateTexture( ctx->params.userPtr, fontImage, x, y, w, h, data );
+static void nvg__flushTextTexture( NVGcontext* ctx )
+{
+	int dirty[ NVG_MAX_FONT_DIRTY_RECTS * 4 ];
+	int i, count, page, pages = fonsGetAtlasPageCount( ctx->fs );
+
+	for( page = 0; page < pages; page++ ) {
+		count = fonsValidatePageRects( ctx->fs, page, dirty, NVG_MAX_FONT_DIRTY_RECTS );
+		if( count > 0 ) {
+			int fontImage = nvg__fontPageImage( ctx, page );
+			// Update texture, a call per rectangle
+			if( fontImage != 0 ) {
+				const unsigned char* data = (const unsigned char*)fonsGetPageData( ctx->fs, page );
+				for( i = 0; i < count; i++ ) {
+					const int* r = dirty + i * 4;
+					ctx->params.renderUpdateTexture( ctx->params.userPtr, fontImage, r[ 0 ], r[ 1 ], r[ 2 ] - r[ 0 ], r[ 3 ] - r[ 1 ], data );
+				}
+			}
 		}
 	}
 }
 
 static int nvg__allocTextAtlas( NVGcontext* ctx )
 {
-	int iw, ih;
+	int i, iw, ih;
 	nvg__flushTextTexture( ctx );
 	if( ctx->fontImageIdx >= NVG_MAX_FONTIMAGES - 1 )
 		return 0;
@@ -2442,17 +2507,24 @@ static int nvg__allocTextAtlas( NVGcontext* ctx )
 		ctx->fontImages[ ctx->fontImageIdx + 1 ] = ctx->params.renderCreateTexture( ctx->params.userPtr, fontAtlasTextureType, iw, ih, 0, NULL );
 	}
 	++ctx->fontImageIdx;
+	// The reset drops all pages but the first one. The draw calls of this frame may use the old page textures, new pages get new textures.
+	for( i = 1; i < NVG_MAX_FONT_PAGES; i++ ) {
+		if( ctx->fontPageImages[ i ] != 0 && ctx->nretiredPageImages < NVG_MAX_FONT_PAGES * NVG_MAX_FONTIMAGES ) {
+			ctx->retiredPageImages[ ctx->nretiredPageImages++ ] = ctx->fontPageImages[ i ];
+			ctx->fontPageImages[ i ] = 0;
+		}
+	}
 	fonsResetAtlas( ctx->fs, iw, ih );
 	return 1;
 }
 
-static void nvg__renderText( NVGcontext* ctx, NVGvertex* verts, int nverts )
+static void nvg__renderText( NVGcontext* ctx, NVGvertex* verts, int nverts, int page )
 {
 	NVGstate* state = nvg__getState( ctx );
 	NVGpaint paint = state->fill;
 
 	// Render triangles.
-	paint.image = ctx->fontImages[ ctx->fontImageIdx ];
+	paint.image = nvg__fontPageImage( ctx, page );
 
 	// Apply global alpha
 	paint.innerColor.a *= state->alpha;
@@ -2461,6 +2533,7 @@ static void nvg__renderText( NVGcontext* ctx, NVGvertex* verts, int nverts )
 #ifdef NANOVG_CLEARTYPE
 	paint.drawingFont = 1;
 #endif
+	paint.distanceField = state->fontDistanceField;
 	ctx->params.renderTriangles( ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts );
 
 	ctx->drawCallCount++;
@@ -2477,6 +2550,7 @@ float nvgText( NVGcontext* ctx, float x, float y, const char* string, const char
 	float invscale = 1.0f / scale;
 	int cverts = 0;
 	int nverts = 0;
+	int page = 0;
 
 	if( end == NULL )
 		end = string + strlen( string );
@@ -2486,6 +2560,7 @@ float nvgText( NVGcontext* ctx, float x, float y, const char* string, const char
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 
@@ -2499,7 +2574,7 @@ float nvgText( NVGcontext* ctx, float x, float y, const char* string, const char
 		float c[ 4 * 2 ];
 		if( iter.prevGlyphIndex == -1 ) { // can not retrieve glyph?
 			if( nverts != 0 ) {
-				nvg__renderText( ctx, verts, nverts );
+				nvg__renderText( ctx, verts, nverts, page );
 				nverts = 0;
 			}
 			if( !nvg__allocTextAtlas( ctx ) )
@@ -2509,6 +2584,14 @@ float nvgText( NVGcontext* ctx, float x, float y, const char* string, const char
 			if( iter.prevGlyphIndex == -1 ) // still can not find glyph?
 				break;
 		}
+		// A draw call samples a single page
+		if( iter.page != page ) {
+			if( nverts != 0 ) {
+				nvg__renderText( ctx, verts, nverts, page );
+				nverts = 0;
+			}
+			page = iter.page;
+		}
 		prevIter = iter;
 		// Transform corners.
 		nvgTransformPoint( &c[ 0 ], &c[ 1 ], state->xform, q.x0*invscale, q.y0*invscale );
@@ -2526,10 +2609,8 @@ float nvgText( NVGcontext* ctx, float x, float y, const char* string, const char
 		}
 	}
 
-	// TODO: add back-end bit to do this just once per frame.
-	nvg__flushTextTexture( ctx );
-
-	nvg__renderText( ctx, verts, nverts );
+	// The atlas is uploaded once by nvgEndFrame, before the back-end renders the draw calls
+	nvg__renderText( ctx, verts, nverts, page );
 
 	return iter.nextx / scale;
 }
@@ -2587,6 +2668,7 @@ int nvgTextGlyphPositions( NVGcontext* ctx, float x, float y, const char* string
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 
@@ -2651,6 +2733,7 @@ int nvgTextBreakLines( NVGcontext* ctx, const char* string, const char* end, flo
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 
@@ -2838,6 +2921,7 @@ float nvgTextBounds( NVGcontext* ctx, float x, float y, const char* string, cons
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 
@@ -2882,6 +2966,7 @@ void nvgTextBoxBounds( NVGcontext* ctx, float x, float y, float breakRowWidth, c
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 	fonsLineBounds( ctx->fs, 0, &rminy, &rmaxy );
@@ -2933,6 +3018,7 @@ void nvgTextMetrics( NVGcontext* ctx, float* ascender, float* descender, float*
 	fonsSetSize( ctx->fs, state->fontSize*scale );
 	fonsSetSpacing( ctx->fs, state->letterSpacing*scale );
 	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
 	fonsSetAlign( ctx->fs, state->textAlign );
 	fonsSetFont( ctx->fs, state->fontId );
 
@@ -2945,6 +3031,141 @@ void nvgTextMetrics( NVGcontext* ctx, float* ascender, float* descender, float*
 		*lineh *= invscale;
 }
 
+int nvgPrewarmGlyphs( NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, NVGglyphPrewarmStats* stats )
+{
+	NVGstate* state = nvg__getState( ctx );
+	float scale = nvg__getFontScale( state ) * ctx->devicePxRatio;
+	FONSprewarmStats fs = { 0, 0, 0 };
+	int i, added = 0;
+
+	fonsSetBlur( ctx->fs, state->fontBlur*scale );
+	fonsSetDistanceField( ctx->fs, state->fontDistanceField );
+	for( i = 0; i < nsizes && !fs.atlasFull; i++ ) {
+		const float size = sizes[ i ] * scale;
+		added += fonsPrewarmGlyphs( ctx->fs, font, &size, 1, ranges, nranges, &fs );
+	}
+
+	// Upload everything with a single texture update
+	nvg__flushTextTexture( ctx );
+
+	if( stats != NULL ) {
+		stats->added = added;
+		stats->atlasFull = fs.atlasFull;
+		fonsGetAtlasSize( ctx->fs, &stats->atlasWidth, &stats->atlasHeight );
+		stats->atlasFree = fs.atlasFree;
+	}
+	return added;
+}
+
+int nvgGlyphRasterThreads( NVGcontext* ctx, int threads )
+{
+	return fonsSetRasterThreads( ctx->fs, threads );
+}
+
+void nvgFontAtlasStats( NVGcontext* ctx, NVGfontAtlasStats* stats )
+{
+	FONSatlasStats fs;
+	if( stats == NULL )
+		return;
+	memset( &fs, 0, sizeof( fs ) );
+	fonsGetAtlasStats( ctx->fs, &fs );
+	stats->glyphsEvicted = fs.glyphsEvicted;
+	stats->evictionPasses = fs.evictionPasses;
+	stats->rectsReused = fs.rectsReused;
+	stats->atlasResets = fs.atlasResets;
+	stats->atlasFree = fs.atlasFree;
+	stats->pages = fs.pages;
+	stats->compactions = fs.compactions;
+	stats->uploads = fs.uploads;
+	stats->frameUploadBytes = fs.frameUploadBytes;
+	stats->lastFrameUploadBytes = fs.lastFrameUploadBytes;
+	stats->glyphsDeferred = fs.glyphsDeferred;
+	stats->glyphsPending = fs.glyphsPending;
+}
+
+int nvgFontAtlasPages( NVGcontext* ctx, int pages )
+{
+	if( pages > NVG_MAX_FONT_PAGES )
+		return 0;
+	return fonsSetMaxAtlasPages( ctx->fs, pages );
+}
+
+int nvgFontAtlasPacker( NVGcontext* ctx, int packer )
+{
+	return fonsSetAtlasPacker( ctx->fs, packer == NVG_FONT_PACKER_SHELF ? FONS_PACKER_SHELF : packer == NVG_FONT_PACKER_SKYLINE ? FONS_PACKER_SKYLINE : -1 );
+}
+
+int nvgCompactFontAtlas( NVGcontext* ctx )
+{
+	return fonsCompactAtlas( ctx->fs );
+}
+
+int nvgFontAtlasAutoCompact( NVGcontext* ctx, float threshold )
+{
+	return fonsSetAutoCompaction( ctx->fs, threshold );
+}
+
+int nvgFontSubpixelPositioning( NVGcontext* ctx, int phases )
+{
+	return fonsSetSubpixelPositioning( ctx->fs, phases );
+}
+
+int nvgFontDistanceFieldSize( NVGcontext* ctx, float size, int spread )
+{
+	return fonsSetDistanceFieldSize( ctx->fs, size, spread );
+}
+
+int nvgFontSizeBuckets( NVGcontext* ctx, float ratio, int settleFrames )
+{
+	return fonsSetSizeBuckets( ctx->fs, ratio, settleFrames );
+}
+
+int nvgFontRasterBudget( NVGcontext* ctx, int glyphs, int microseconds )
+{
+	return fonsSetRasterBudget( ctx->fs, glyphs, microseconds );
+}
+
+int nvgFontAsyncRasterization( NVGcontext* ctx, int enabled )
+{
+	return fonsSetAsyncRasterization( ctx->fs, enabled );
+}
+
+int nvgTextUnfinishedGlyphs( NVGcontext* ctx )
+{
+	return fonsGetUnfinishedGlyphs( ctx->fs );
+}
+
+int nvgSaveFontCache( NVGcontext* ctx, const char* path )
+{
+	return fonsSaveCache( ctx->fs, path );
+}
+
+int nvgLoadFontCache( NVGcontext* ctx, const char* path )
+{
+	int iw, ih, fw, fh;
+	int fontImage = ctx->fontImages[ ctx->fontImageIdx ];
+
+	if( !fonsLoadCache( ctx->fs, path ) )
+		return 0;
+
+	// The atlas in the file may have another size
+	fonsGetAtlasSize( ctx->fs, &fw, &fh );
+	iw = ih = 0;
+	if( fontImage != 0 )
+		nvgImageSize( ctx, fontImage, &iw, &ih );
+	if( fontImage == 0 || iw != fw || ih != fh ) {
+		if( fontImage != 0 )
+			nvgDeleteImage( ctx, fontImage );
+		fontImage = ctx->params.renderCreateTexture( ctx->params.userPtr, fontAtlasTextureType, fw, fh, 0, NULL );
+		ctx->fontImages[ ctx->fontImageIdx ] = fontImage;
+		if( fontImage == 0 )
+			return 0;
+	}
+
+	nvg__flushTextTexture( ctx );
+	return 1;
+}
+
 int nvgDebugDumpFontAtlas( NVGcontext* ctx, const char* path )
 {
 	if( nullptr == ctx || nullptr == ctx->fs )
@@ -53,6 +53,8 @@ struct NVGpaint {
 #ifdef NANOVG_CLEARTYPE
 	int drawingFont;
 #endif
+	// Non-zero when the image is the signed distance field of the glyphs
+	int distanceField;
 };
 typedef struct NVGpaint NVGpaint;
 
@@ -138,6 +140,35 @@ struct NVGtextRow {
 };
 typedef struct NVGtextRow NVGtextRow;
 
+struct NVGglyphPrewarmStats {
+	int added;			// Count of glyphs rasterized into the atlas.
+	int atlasFull;		// 1 if the function stopped because the atlas is full.
+	int atlasWidth, atlasHeight;	// Current size of the font atlas.
+	int atlasFree;		// Atlas area still available for new glyphs, in pixels.
+};
+typedef struct NVGglyphPrewarmStats NVGglyphPrewarmStats;
+
+struct NVGfontAtlasStats {
+	int glyphsEvicted;	// Glyphs evicted from the atlas to make room for new ones, least recently used first.
+	int evictionPasses;	// Count of the times the atlas was full and some glyphs were evicted.
+	int rectsReused;	// Glyphs placed into the space released by the evicted glyphs.
+	int atlasResets;	// Count of the times the atlas was reset, because the eviction was not enough.
+	int atlasFree;		// Atlas area still available for new glyphs, in pixels.
+	int pages;			// Current count of the atlas pages.
+	int compactions;	// Count of the times the glyphs were repacked to reclaim the space of the evicted ones.
+	int uploads;		// Count of the atlas rectangles uploaded to the textures, the close ones are merged into one.
+	int frameUploadBytes;		// Bytes uploaded since nvgBeginFrame.
+	int lastFrameUploadBytes;	// Bytes uploaded in the previous frame.
+	int glyphsDeferred;	// Glyphs deferred to later frames by the rasterization budget or the background thread.
+	int glyphsPending;	// Deferred glyphs not rasterized yet, the text using them is not final.
+};
+typedef struct NVGfontAtlasStats NVGfontAtlasStats;
+
+enum NVGfontPacker {
+	NVG_FONT_PACKER_SKYLINE = 0,	// Bottom-left skyline, the tightest packing of mixed glyph sizes.
+	NVG_FONT_PACKER_SHELF = 1,		// Shelves of similar glyph heights, constant time allocation, reuses the space of evicted glyphs.
+};
+
 enum NVGimageFlags {
     NVG_IMAGE_GENERATE_MIPMAPS	= 1<<0,     // Generate mipmaps during creation of the image.
 	NVG_IMAGE_REPEATX			= 1<<1,		// Repeat image in X direction.
@@ -160,7 +191,7 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 // Cancels drawing the current frame.
 void nvgCancelFrame(NVGcontext* ctx);
 
-// Ends drawing flushing remaining render state.
+// Ends drawing flushing remaining render state. Glyphs added to the font atlas during the frame are uploaded here, with a texture update per dirty rectangle, before the draw calls are rendered.
 void nvgEndFrame(NVGcontext* ctx);
 
 //
@@ -548,13 +579,20 @@ void nvgStroke(NVGcontext* ctx);
 // Note: currently only solid color fill is supported for text.
 
 // Creates font by loading it from the disk from specified file name.
+// The file is memory mapped, and shared by all contexts which load the same path.
 // Returns handle to the font.
 int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename);
 
 // Creates font by loading it from the specified memory chunk.
+// With freeData, the memory must come from malloc(), and it's owned and freed by the font, otherwise it's copied.
 // Returns handle to the font.
 int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData);
 
+// Creates font from the specified memory chunk without copying it.
+// The memory must stay valid until the context is deleted. Several contexts may share the same chunk.
+// Returns handle to the font.
+int nvgCreateFontMemStatic(NVGcontext* ctx, const char* name, const unsigned char* data, int ndata);
+
 // Finds a loaded font of specified name, and returns handle to it, or -1 if the font is not found.
 int nvgFindFont(NVGcontext* ctx, const char* name);
 
@@ -567,9 +605,14 @@ int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallba
 // Sets the font size of current text style.
 void nvgFontSize(NVGcontext* ctx, float size);
 
-// Sets the blur of current text style.
+// Sets the blur of current text style. Blurred glyphs are made from the sharp ones, which are added to the font atlas too.
+// In ClearType builds the blurred glyphs are grayscale, without sub-pixels.
 void nvgFontBlur(NVGcontext* ctx, float blur);
 
+// Non-zero draws the current text style with the signed distance field glyphs, rendered once and scaled to any size and transform.
+// Use it for zoomed or animated text, it doesn't rasterize new glyphs when the size changes. The blur is ignored, and small text is sharper without it.
+void nvgFontDistanceField(NVGcontext* ctx, int enabled);
+
 // Sets the letter spacing of current text style.
 void nvgTextLetterSpacing(NVGcontext* ctx, float spacing);
 
@@ -617,6 +660,76 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
 int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows);
 
+// Rasterizes glyphs of the specified font into the font atlas ahead of time, e.g. during loading screens, so the first frame which draws them doesn't stall.
+// Sizes are in the same units as nvgFontSize, scaled by the current transform and device pixel ratio the same way nvgText does. Font blur and the distance field mode
+// are taken from the current text style, the size buckets are applied like in nvgText, so the prewarmed glyphs are the ones nvgText looks up.
+// Parameter ranges should be a pointer to 2*nranges codepoints, [first, last] pairs with both ends inclusive. Codepoints missing from the font and its fallbacks are skipped.
+// All new glyphs are uploaded with a single texture update. When the atlas is full the function stops, it never resets the atlas.
+// Returns count of glyphs added. Parameter stats is optional.
+int nvgPrewarmGlyphs(NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges, NVGglyphPrewarmStats* stats);
+
+// Sets count of threads to rasterize glyphs, including the calling one. Used for nvgPrewarmGlyphs and for text with many glyphs missing from the atlas, e.g. cold CJK screens.
+// The glyphs are still packed into the atlas on the calling thread, the atlas layout doesn't depend on the threads count. 0 or 1 disables the worker threads, this is the default.
+// Returns 0 if failed to create the threads.
+int nvgGlyphRasterThreads(NVGcontext* ctx, int threads);
+
+// Returns counters of the font atlas. They are cumulative since the context was created.
+// When the atlas is full, glyphs not used in the current frame are evicted, the least recently used first. The atlas is only reset when that's not enough.
+void nvgFontAtlasStats(NVGcontext* ctx, NVGfontAtlasStats* stats);
+
+// Sets the maximum count of font atlas pages, every page is a separate texture of the current atlas size. The default is 1.
+// When the atlas is full, another page is added before evicting glyphs or resetting the atlas, so the memory grows in page-sized steps.
+// Text draw calls are split where the glyphs switch pages. Returns 0 if the count is out of range.
+int nvgFontAtlasPages(NVGcontext* ctx, int pages);
+
+// Selects how the glyphs are packed into the font atlas, the default is NVG_FONT_PACKER_SKYLINE.
+// The shelf packer is faster and reuses the space of evicted glyphs better when the text uses a few sizes, the skyline packs mixed sizes tighter.
+// Changing the packer resets the font atlas, call this before drawing text. Returns 0 if the value is invalid.
+int nvgFontAtlasPacker(NVGcontext* ctx, int packer);
+
+// Repacks the glyphs of the font atlas tightly, reclaiming the holes left by the evicted glyphs, e.g. at idle time. The glyphs are not rasterized again.
+// Call outside of nvgBeginFrame/nvgEndFrame, the text drawn before in the frame would use stale texture coordinates. Returns 0 and keeps the atlas if failed.
+int nvgCompactFontAtlas(NVGcontext* ctx);
+
+// Compacts the font atlas in nvgBeginFrame when the share of the used atlas area not covered by glyphs is above the threshold, between 0 and 1.
+// Only checked after some glyphs were evicted. 0 disables, this is the default. Returns 0 if the threshold is out of range.
+int nvgFontAtlasAutoCompact(NVGcontext* ctx, float threshold);
+
+// Positions text at fractions of a pixel horizontally, so slowly moving or scrolling text doesn't jitter. Phases is 2, 4 or 8 positions per pixel, 1 disables, this is the default.
+// Every glyph is rasterized once for each phase it's drawn at, so the atlas holds at most that many copies of a glyph. The advances are no longer rounded to whole pixels.
+// Returns 0 if the count is invalid.
+int nvgFontSubpixelPositioning(NVGcontext* ctx, int phases);
+
+// Sets the reference size in pixels of the distance field glyphs, 8 to 256, and how far the field extends outside of the outlines, 1 to 16 reference pixels.
+// The default is 32 and 4. Returns 0 if the values are invalid.
+int nvgFontDistanceFieldSize(NVGcontext* ctx, float size, int spread);
+
+// Rasterizes text at the nearest size of a geometric ladder with the ratio between the steps, and scales the glyphs to the size, so a zoom animation
+// rasterizes a bounded number of glyphs. A size drawn in more than settleFrames consecutive frames is rasterized exactly, 0 always uses the ladder.
+// The ratio is above 1 and up to 2, 0 disables, this is the default. Returns 0 if the values are invalid.
+int nvgFontSizeBuckets(NVGcontext* ctx, float ratio, int settleFrames);
+
+// Limits the glyphs rasterized per frame, by count and by time in microseconds, 0 is no limit, this is the default for both.
+// The glyphs over the budget are rasterized by the following nvgBeginFrame calls. Until then the text draws them from another recently drawn size,
+// scaled, or leaves them blank with their advance. nvgFontAtlasStats reports the pending ones. Returns 0 if the values are negative.
+int nvgFontRasterBudget(NVGcontext* ctx, int glyphs, int microseconds);
+
+// Rasterizes the missing glyphs on a background thread, disabled by default. The text draws them like the glyphs over the rasterization budget,
+// and nvgBeginFrame adds the finished ones to the atlas. Returns 0 if failed to create the thread.
+int nvgFontAsyncRasterization(NVGcontext* ctx, int enabled);
+
+// Returns count of the glyphs drawn since nvgBeginFrame which were not rasterized yet. When it's not 0, redraw the next frame to show the complete text.
+int nvgTextUnfinishedGlyphs(NVGcontext* ctx);
+
+// Saves the font atlas and the cached glyphs of all fonts into a file, to skip rasterization on the next start.
+// Returns 0 if failed.
+int nvgSaveFontCache(NVGcontext* ctx, const char* path);
+
+// Loads the file written by nvgSaveFontCache. The fonts must be created from the same files in the same order, with the same fallbacks.
+// Files written by another version of FreeType or another build of the library are rejected. The whole atlas is uploaded with a single texture update.
+// Call outside of nvgBeginFrame/nvgEndFrame. Returns 0 and keeps the current atlas if the file doesn't match.
+int nvgLoadFontCache(NVGcontext* ctx, const char* path);
+
 //
 // Internal Render API
 //
@@ -19,6 +19,7 @@ enum GLNVGshaderType
 	NSVG_SHADER_SIMPLE,
 	NSVG_SHADER_IMG,
 	NSVG_SHADER_CLEARTYPE,	// Only used when NANOVG_CLEARTYPE is defined
+	NSVG_SHADER_DISTANCE_FIELD,
 };
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
@@ -419,6 +420,9 @@ static int glnvg__renderCreate( void* uptr )
 		"#define NANOVG_GL3 1\n"
 #elif defined NANOVG_GLES2
 		"#version 100\n"
+		"#ifdef GL_OES_standard_derivatives\n"
+		"#extension GL_OES_standard_derivatives : enable\n"
+		"#endif\n"
 		"#define NANOVG_GL2 1\n"
 #elif defined NANOVG_GLES3
 		"#version 300 es\n"
@@ -615,6 +619,23 @@ void main(void)
 		result *= scissor;
 	}
 #endif
+	else if (type == 5)		// Signed distance field glyphs, GLNVGshaderType::NSVG_SHADER_DISTANCE_FIELD
+	{
+#ifdef NANOVG_GL3
+		float dist = texture(tex, ftcoord).x;
+#else
+		float dist = texture2D(tex, ftcoord).x;
+#endif
+#if defined(GL_ES) && !defined(NANOVG_GL3) && !defined(GL_OES_standard_derivatives)
+		// Change of the field over a pixel at the reference size with the default spread
+		float width = 0.125;
+#else
+		// Change of the field over a pixel of the screen, smooths the edge over a pixel at any scale and rotation
+		float width = length(vec2(dFdx(dist), dFdy(dist)));
+#endif
+		float coverage = clamp((dist - 128.0 / 255.0) / max(width, 1.0 / 1024.0) + 0.5, 0.0, 1.0);
+		result = innerCol * (coverage * scissor);
+	}
 #ifdef NANOVG_GL3
 	outColor = result;
 #else
@@ -1473,10 +1494,13 @@ static void glnvg__renderTriangles( void* uptr, NVGpaint* paint, NVGcompositeOpe
 	frag = nvg__fragUniformPtr( gl, call->uniformOffset );
 	glnvg__convertPaint( gl, frag, paint, scissor, 1.0f, 1.0f, -1.0f );
 
+	if( paint->distanceField )
+		frag->type = (float)NSVG_SHADER_DISTANCE_FIELD;
+	else
 #ifdef NANOVG_CLEARTYPE
-	frag->type = (float)( ( paint->drawingFont ) ? NSVG_SHADER_CLEARTYPE : NSVG_SHADER_IMG );
+		frag->type = (float)( ( paint->drawingFont ) ? NSVG_SHADER_CLEARTYPE : NSVG_SHADER_IMG );
 #else
-	frag->type = (float)NSVG_SHADER_IMG;
+		frag->type = (float)NSVG_SHADER_IMG;
 #endif
 	return;
 